@@ -1,11 +1,56 @@
 #pragma once
 
 #include <string>
+#include <functional>
 
 /* =================================== Public API's =================================== */
 #ifdef __cplusplus    // If used by C++ code,
 
 std::string base64_encode(unsigned char const*, unsigned int len);
 std::string base64_decode(std::string const& s);
+size_t base64_decoded_length(std::string const& s);		/* Of well-formed (optionally padded) input */
+
+/* Incremental codec for payloads too large to hold twice in memory: input comes in arbitrary chunks,
+   output goes to the sink in chunks of at most chunkSize bytes. A sink returning false aborts the stream */
+typedef std::function<bool(const char *data, const size_t &length)> Base64Sink;
+
+class Base64StreamEncoder {
+
+private:
+	Base64Sink sink;
+	std::string buffer;
+	size_t used;
+	unsigned char carry[3];				/* Input short of a whole 3-byte group */
+	size_t carryLength;
+	bool failed;
+
+private:
+	bool flush(void);
+
+public:
+	explicit Base64StreamEncoder(const Base64Sink &sink, const size_t &chunkSize = 64 * 1024);
+	bool update(const void *data, size_t length);
+	bool finish(void);					/* Emits the padded final group */
+};
+
+class Base64StreamDecoder {
+
+private:
+	Base64Sink sink;
+	std::string buffer;
+	size_t used;
+	unsigned char carry[4];				/* Input short of a whole 4-char quad */
+	size_t carryLength;
+	bool ended;							/* Reached '=' or a non-base64 character, the rest is ignored as base64_decode() does */
+	bool failed;
+
+private:
+	bool flush(void);
+
+public:
+	explicit Base64StreamDecoder(const Base64Sink &sink, const size_t &chunkSize = 64 * 1024);
+	bool update(const char *data, size_t length);
+	bool finish(void);
+};
 
 #endif
@@ -0,0 +1,76 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+struct HttpResponse {
+	int statusCode = 0;
+	std::vector<std::pair<std::string, std::string>> headers;	/* Header names are lower-cased */
+	std::string body;											/* Raw bytes, de-chunked, may contain NULs */
+	bool keepAlive = false;										/* Peer allows the connection to be reused */
+
+	std::string header(const std::string &lowerCaseName) const;
+};
+
+/* Incremental HTTP/1.x response parser; feed it bytes as they arrive from the socket */
+class HttpResponseParser {
+
+public:
+	enum class State {
+		StatusLine,
+		Headers,
+		Body,
+		BodyUntilClose,
+		ChunkSize,
+		ChunkData,
+		ChunkDataEnd,
+		Trailers,
+		Complete,
+		Error
+	};
+
+private:
+	State state;
+	std::string line;				/* Partial line carried over between feed() calls */
+	size_t bytesRemaining;			/* Of the Content-Length body or of the current chunk */
+	HttpResponse response;
+
+private:
+	bool readLine(const char *&data, const char *end);
+	void parseStatusLine(void);
+	void parseHeaderLine(void);
+	void onHeadersComplete(void);
+	void parseChunkSize(void);
+
+public:
+	HttpResponseParser() { reset(); }
+
+public:
+	void reset(void);
+	size_t feed(const char *data, size_t length);	/* Returns the number of bytes consumed, stops at the end of the message */
+	void finish(void);								/* Peer closed the connection */
+	bool isComplete(void) const { return state == State::Complete; }
+	bool hasError(void) const { return state == State::Error; }
+	HttpResponse& getResponse(void) { return response; }
+};
@@ -0,0 +1,39 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/* A job request from the server, parsed once on arrival and handed to a worker as is */
+class Job {
+
+private:
+	std::unordered_map<std::string, std::string> fields;	/* UTF-8 string members of the request */
+	std::wstring jobMode;
+
+public:
+	static bool parseAll(const std::string &utf8JsonData, std::vector<Job> &jobs);	/* A job object or an array of them, in one parse */
+	const std::wstring& mode(void) const;
+	std::wstring value(const std::string &key) const;					/* Empty if the job has no such field */
+	const std::string& valueUtf8(const std::string &key) const;			/* Raw field, i.e. base64 payloads that need no conversion */
+};
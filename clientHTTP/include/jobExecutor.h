@@ -0,0 +1,59 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+enum class JobLane : unsigned int {
+	IoHeavy,		/* Transfers, copies, external processes: may block for minutes */
+	Light			/* Quick filesystem queries/updates i.e. listDir, deleteFile */
+};
+
+/* Fixed pool of worker threads per lane, each lane with its own bounded queue */
+class JobExecutor {
+
+private:
+	struct Lane {
+		std::queue<std::function<void()>> tasks;
+		std::condition_variable taskAvailable;
+		std::vector<std::thread> workers;
+	};
+
+private:
+	Lane lanes[2];
+	std::mutex lanesMutex;
+	const size_t queueCapacity;
+	bool stopping;
+
+private:
+	void worker(Lane &lane);
+
+public:
+	JobExecutor(const size_t &ioHeavyWorkers, const size_t &lightWorkers, const size_t &queueCapacityPerLane);
+	bool submit(const JobLane &lane, std::function<void()> task);	/* false if the lane's queue is full or the executor is stopping */
+	void shutdown(void);											/* Runs the queued tasks and joins the workers */
+	~JobExecutor() { shutdown(); }
+};
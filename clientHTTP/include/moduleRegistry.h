@@ -0,0 +1,74 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
+#ifdef _WIN32
+#include <Windows.h>
+typedef HMODULE ModuleHandle;
+#else
+typedef void* ModuleHandle;
+#endif
+
+namespace fs = std::filesystem;
+
+/* A module (.dll) mapped from a private copy, so the original file stays replaceable while the module is in use */
+class LoadedModule {
+
+private:
+	ModuleHandle hModule;
+	fs::path shadowPath;
+	mutable std::unordered_map<std::string, void*> functions;		/* Entry points resolved so far */
+	mutable std::mutex functionsMutex;
+
+public:
+	LoadedModule(const ModuleHandle &hModule, const fs::path &shadowPath);
+	LoadedModule(const LoadedModule&) = delete;
+	LoadedModule& operator=(const LoadedModule&) = delete;
+	~LoadedModule();											/* Calls its ShutdownModule() if exported, unloads it and deletes its copy */
+	void* function(const char *functionName) const;				/* nullptr if the module doesn't export it */
+};
+
+/* Keeps the modules alongside the executable loaded across jobs. A module is reloaded only once its file on disk
+   changes (last write time/size), jobs still running on the previous version keep it alive until they finish */
+class ModuleRegistry {
+
+private:
+	struct Entry {
+		std::shared_ptr<const LoadedModule> module;
+		fs::file_time_type lastWriteTime;
+		uintmax_t fileSize;
+	};
+	static std::unordered_map<std::wstring, Entry> modules;
+	static std::mutex modulesMutex;
+
+private:
+	static fs::path shadowDirectory(void);
+	static fs::path modulePath(const std::wstring &moduleName);
+	static std::shared_ptr<const LoadedModule> load(const fs::path &path);
+
+public:
+	static std::shared_ptr<const LoadedModule> acquire(const std::wstring &moduleName);	/* nullptr if the module is missing or won't load */
+};
@@ -0,0 +1,79 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+#include <atomic>
+
+/*
+	Unbounded multi-producer single-consumer queue, job threads push and only the HTTP thread pops.
+	push() is one atomic exchange and pop() touches no shared state besides the node it takes,
+	values are moved in and out so a large result is never copied. The consumer is woken by
+	whoever pushes (see SharedResourceManager's response event), the queue itself never blocks.
+*/
+template <typename T>
+class MpscQueue {
+
+private:
+	struct Node {
+		std::atomic<Node*> next;
+		T value;
+		Node() : next(nullptr) {}
+		explicit Node(T &&value) : next(nullptr), value(std::move(value)) {}
+	};
+
+	std::atomic<Node*> head;				/* Last linked node, producers swap themselves in here */
+	Node *tail;								/* Consumer only, a stub whose value has already been taken */
+
+public:
+	MpscQueue() : head(new Node), tail(head.load()) {}
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue() {
+		T value;
+		while (pop(value)) {}
+		delete tail;
+	}
+
+	/* Any thread */
+	void push(T &&value) {
+		Node *node = new Node(std::move(value));
+		Node *previous = head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	/* Consumer thread only, false if nothing is queued */
+	bool pop(T &value) {
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr) {
+			return false;						// Empty, or a producer is between its exchange and its link
+		}
+		value = std::move(next->value);
+		delete tail;
+		tail = next;
+		return true;
+	}
+
+	/* Consumer thread only, next value pop() would return or nullptr, valid until that pop() */
+	T* front(void) {
+		Node *next = tail->next.load(std::memory_order_acquire);
+		return (next != nullptr) ? &next->value : nullptr;
+	}
+};
@@ -26,10 +26,22 @@
 #include <mutex>
 #include <filesystem>
 #include "sharedResourceManager.h"
+#include "jobExecutor.h"
+#include "job.h"
 
 namespace fs = std::filesystem;
 
 
-void httpService_t(SharedResourceManager &sharedResources);
-bool isJobAvailable(const std::wstring& replyFromServer);
-void startJob_t(SharedResourceManager &sharedResources);
+void httpService_t(SharedResourceManager &sharedResources, JobExecutor &jobExecutor);
+/* A job handler fills in the reply: replyType defaults to "log" */
+typedef void (*JobHandler)(const Job &job, std::wstring &replyType, std::wstring &dataToSend);
+
+struct JobMode {
+	const wchar_t *name;
+	JobHandler handler;
+	JobLane lane;
+};
+
+bool findJobMode(const std::wstring &mode, JobMode &jobMode);
+bool registerJobMode(const std::wstring &mode, const JobHandler &handler, const JobLane &lane);	/* i.e. modes provided by plugin modules */
+void startJob_t(SharedResourceManager &sharedResources, const Job &job, const JobHandler &handler);
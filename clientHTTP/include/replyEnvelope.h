@@ -0,0 +1,39 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+#include <string>
+
+/*
+	Job replies are the constant sysInfo object plus one "<replyType>":"<data>" member.
+	sysInfo is serialized once into a prefix (without its closing brace), every reply
+	then streams prefix + escaped member straight into base64, so a large reply costs
+	a single pass over its data and never goes through a rapidjson Document.
+*/
+class ReplyEnvelope {
+
+private:
+	std::string prefix;					/* UTF-8, e.g. {"id":"..","OSname":".." */
+	bool hasMembers;					/* Whether the reply member needs a leading comma */
+
+public:
+	explicit ReplyEnvelope(const std::string &utf8SysInfoJson);
+	std::string encode(const std::string &replyType, const std::string &data) const;	/* base64 of the whole reply, ready for pushResponse() */
+};
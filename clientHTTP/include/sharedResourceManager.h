@@ -20,30 +20,60 @@
 
 
 #pragma once
-#include <queue>
+#include "tcpNetworkManager.h"	/* Always use this header at the top */
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <filesystem>
+#include "mpscQueue.h"
+#include "replyEnvelope.h"
+
+/* A queued request body, held in memory or, while the queue is over its memory budget, in a spill file */
+struct QueuedResponse {
+	std::string body;
+	std::filesystem::path spillFile;				/* Empty unless spilled */
+	size_t length = 0;
+};
 
 class SharedResourceManager {
 
 private:
-	std::queue<std::wstring> responseQueue;
-	std::mutex responseQueueMutex;
-	std::queue<std::wstring> jobQueue;
-	std::mutex jobQueueMutex;
-	std::wstring jsonSysInfo;
+	MpscQueue<QueuedResponse> responseQueue;		/* base64 encoded request bodies, ready to transmit */
+	const size_t memoryBudget;						/* Bytes of queued responses kept in RAM, further ones are spilled to disk */
+	const size_t highWaterMark;						/* Bytes of queued responses (RAM + disk) above which new jobs are refused */
+	std::atomic<size_t> memoryBytes;
+	std::atomic<size_t> spilledBytes;
+	std::atomic<unsigned int> spillCount;
+	std::filesystem::path spillDir;					/* Private to this account, created by the first spill */
+	std::once_flag spillDirOnce;
+	mysocket::WakeEvent responseEvent;				/* Signaled by pushResponse(), wakes the HTTP thread out of a socket wait */
+	std::string jsonSysInfo;						/* UTF-8 */
+	std::shared_ptr<const ReplyEnvelope> replyEnvelope;	/* Pre-serialized jsonSysInfo, rebuilt by setSysInfoInJson() */
 	std::mutex jsonSysInfoMutex;
-	std::wstring serverUrl;
+	std::string serverUrl;							/* host:port */
 	std::mutex serverUrlMutex;
 
+private:
+	bool spill(QueuedResponse &response);
+
+public:
+	SharedResourceManager(const size_t &memoryBudget, const size_t &highWaterMark);
+	SharedResourceManager(const SharedResourceManager&) = delete;
+	SharedResourceManager& operator=(const SharedResourceManager&) = delete;
+	~SharedResourceManager();											/* Removes the spill directory, with the responses never sent */
 
 public:
-	void pushResponse(const std::wstring &response);
-	std::wstring popResponse(void);
-	void pushJob(const std::wstring &job);
-	std::wstring popJob(void);
-	bool isResponseAvailable(void);
-	void setSysInfoInJson(const std::wstring &sysInfoJson);
-	std::wstring getSysInfoInJson(void);
-	void setServerUrl(const std::wstring &url);
-	std::wstring getServerUrl(void);
+	void pushResponse(std::string &&response);							/* Any thread */
+	bool popResponse(std::string &response);							/* HTTP thread only, false if nothing is queued */
+	size_t peekResponseLength(void);									/* HTTP thread only, 0 if nothing is queued */
+	size_t pendingResponseBytes(void);									/* Any thread, RAM + disk */
+	bool isResponseBacklogged(void);									/* Any thread, true above the high-water mark */
+	mysocket::WakeEvent& getResponseEvent(void);
+	void setSysInfoInJson(const std::string &sysInfoJson);
+	std::string getSysInfoInJson(void);
+	std::shared_ptr<const ReplyEnvelope> getReplyEnvelope(void);
+	void setServerUrl(const std::string &url);
+	std::string getServerUrl(void);
 };
\ No newline at end of file
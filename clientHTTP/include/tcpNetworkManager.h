@@ -21,11 +21,27 @@
 #pragma once
 //#pragma comment(lib, "Ws2_32.lib") /* Linking against the Ws2_32.lib library */
 
+#ifdef _WIN32
 #include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/time.h>
+#include <cstdint>
+#endif
 #include <iostream>
 #include <ctime>
+#include <string>
+#include <vector>
+#include <initializer_list>
+#include "httpResponseParser.h"
 
 
+/* A span of pre-encoded bytes, transmitted without being copied */
+struct ConstBuffer {
+	const char *data;
+	size_t length;
+};
+
 enum class ConnectionBehaviour : unsigned int {
 	DropConnection,
 	KeepAlive,
@@ -34,16 +50,84 @@ enum class ConnectionBehaviour : unsigned int {
 
 namespace mysocket {
 
-	class WinSocket {
+	/* Manual-reset event a Transport can wait on alongside its socket, lets another thread cut the wait short */
+	class WakeEvent {
+
+	private:	/*	Attributes	*/
+#ifdef _WIN32
+		WSAEVENT event;
+#else
+		int event_fd;
+#endif
+
+	public:
+		WakeEvent();
+		WakeEvent(const WakeEvent&) = delete;
+		WakeEvent& operator=(const WakeEvent&) = delete;
+		~WakeEvent();
+
+	public:	/* Public API's */
+		void signal(void);			/* Any thread */
+		void reset(void);			/* Before consuming whatever the event announced, so a later signal() is never lost */
+#ifdef _WIN32
+		WSAEVENT handle(void) const { return event; }
+#else
+		int handle(void) const { return event_fd; }
+#endif
+	};
+
+	/* HTTP client transport used by httpService_t; each platform implements the socket primitives */
+	class Transport {
+
+	protected:	/*	Attributes	*/
+		ConnectionBehaviour connectionBehaviour;
+		HttpResponseParser responseParser;
+		std::vector<char> receiveBuffer;
+
+	protected:	/*	Platform primitives	*/
+		virtual int waitForReadable(const struct timeval &timeout) = 0;		/* > 0 readable, 0 on timeout, < 0 on error */
+		virtual int waitForReadableOrWake(const struct timeval &timeout, const WakeEvent &wake) = 0;	/* As above, 0 also when wake is signaled */
+		virtual long receiveSome(char *buffer, const size_t &length) = 0;	/* > 0 bytes read, 0 if peer closed, < 0 on error */
+
+	protected:	/*	Functions	*/
+		bool isPeerConnectionAlive(void);		/* false if an idle connection was closed/reset by the peer */
+		void drainUntilPeerDropsConnection(const struct timeval &timeout);
+
+	public:
+		/* Constructor */
+		Transport() : connectionBehaviour(ConnectionBehaviour::WaitForPeerToDropConnection),
+			receiveBuffer(16 * 1024) {
+		};
+
+	public:	/* Public API's */
+		virtual void socket_init(void) = 0;
+		void setConnectionBehaviour(const ConnectionBehaviour &behaviour);
+		virtual void connect(const std::string &url, const std::string &port_num) = 0;	/* With KeepAlive, reuses the current connection if the peer hasn't dropped it */
+		virtual bool transmit(std::initializer_list<ConstBuffer> buffers) = 0;			/* Gather-write of all buffers, in order */
+		bool waitForResponse(const struct timeval &timeout, const WakeEvent &wake);	/* false if nothing arrived within timeout or as soon as wake is signaled */
+		bool receiveResponse(HttpResponse &response, const struct timeval &timeout);	/* timeout applies to each wait for incoming data */
+		virtual bool isConnected(void) = 0;
+		virtual void socket_close() = 0;		/* This closes the socket but DOES NOT release the internal resources */
+		virtual void socket_cleanup() = 0;		/* Close the socket and release the resources */
+
+	public:		/*	Destructor	*/
+		virtual ~Transport() {}
+	};
+
+#ifdef _WIN32
+	class WinSocket : public Transport {
 
 	private:	/*	Attributes	*/
 		WSADATA wsaData;
 		int socket_type;
 		int protocol;
 		struct sockaddr_in sockaddr_in;
+		WSAEVENT socketEvent;
 		
-	private:	/*	Functions	*/
-		bool isConnected(void);
+	private:	/*	Platform primitives	*/
+		int waitForReadable(const struct timeval &timeout) override;
+		int waitForReadableOrWake(const struct timeval &timeout, const WakeEvent &wake) override;
+		long receiveSome(char *buffer, const size_t &length) override;
 
 	private:	/* Error handlers for windows socket API's */		
 		void Err_handle_WSAStartup(const int& err_code);
@@ -61,7 +145,7 @@ namespace mysocket {
 	public:
 		/* Constructor */
 		WinSocket() : http_socket(INVALID_SOCKET),
-			socket_type(SOCK_STREAM) {
+			socket_type(SOCK_STREAM), socketEvent(WSA_INVALID_EVENT) {
 			wsaData = { NULL };
 		};
 
@@ -69,14 +153,55 @@ namespace mysocket {
 		SOCKET http_socket;
 			
 	public:	/* Public API's */	
-		void socket_init(void);
-		void connect(const std::wstring &url, const std::wstring &port_num);
-		void transmit(const std::wstring &data, const int& data_size_in_bytes);
-		void receiveResponse(std::wstring &recievedData, const struct timeval &timeout);
-		void socket_close();			/* This closes the socket but DOES NOT release the internal resources */
-		void socket_cleanup();			/* Close the socket and release the resources */
+		void socket_init(void) override;
+		void connect(const std::string &url, const std::string &port_num) override;
+		bool transmit(std::initializer_list<ConstBuffer> buffers) override;
+		bool isConnected(void) override;
+		void socket_close() override;
+		void socket_cleanup() override;
 		
 	public:		/*	Destructor	*/ 
 		virtual ~WinSocket() { socket_cleanup(); }		/* In case if user forget to cleanup or exception caught */
 	};
-}
\ No newline at end of file
+
+	using TcpSocket = WinSocket;
+#else
+	/* Non-blocking sockets driven by epoll, lets the agent core run and be load-tested on Linux */
+	class PosixSocket : public Transport {
+
+	private:	/*	Attributes	*/
+		int epoll_fd;
+		uint32_t registeredEvents;
+		struct sockaddr_in sockaddr_in;
+		static constexpr int ioTimeout_ms{ 30 * 1000 };		/* Bounds connect() and a stalled send() */
+
+	private:	/*	Functions	*/
+		int waitFor(const uint32_t &events, const int &timeout_ms);
+
+	private:	/*	Platform primitives	*/
+		int waitForReadable(const struct timeval &timeout) override;
+		int waitForReadableOrWake(const struct timeval &timeout, const WakeEvent &wake) override;
+		long receiveSome(char *buffer, const size_t &length) override;
+
+	public:
+		/* Constructor */
+		PosixSocket() : epoll_fd(-1), registeredEvents(0), sockaddr_in(), http_socket(-1) {};
+
+	public:	/*	Attributes	*/
+		int http_socket;
+
+	public:	/* Public API's */
+		void socket_init(void) override;
+		void connect(const std::string &url, const std::string &port_num) override;
+		bool transmit(std::initializer_list<ConstBuffer> buffers) override;
+		bool isConnected(void) override;
+		void socket_close() override;
+		void socket_cleanup() override;
+
+	public:		/*	Destructor	*/
+		virtual ~PosixSocket() { socket_cleanup(); }
+	};
+
+	using TcpSocket = PosixSocket;
+#endif
+}
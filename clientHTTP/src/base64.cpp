@@ -1,91 +1,444 @@
 #include "base64.h"
-#include <iostream>
+#include <cstdint>
 
-static const std::string base64_chars =
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BASE64_TARGET(isa)
+#else
+#include <cpuid.h>
+#define BASE64_TARGET(isa) __attribute__((target(isa)))		// Kernels are built for their ISA, the rest of the file stays baseline
+#endif
+#endif
+
+static const char base64_chars[] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
 "abcdefghijklmnopqrstuvwxyz"
 "0123456789+/";
 
+/* Reverse lookup: character ---> 6-bit value, -1 for anything that isn't base64 (including '=') */
+struct Base64DecodeTable {
+	int8_t value[256];
+	constexpr Base64DecodeTable() : value() {
+		for (int c = 0; c < 256; ++c) { value[c] = -1; }
+		for (int i = 0; i < 64; ++i) { value[static_cast<unsigned char>(base64_chars[i])] = static_cast<int8_t>(i); }
+	}
+};
+static constexpr Base64DecodeTable base64_values{};
+
 
-static inline bool is_base64(unsigned char c) {
-	return (isalnum(c) || (c == '+') || (c == '/'));
+/* ================================ SCALAR ================================ */
+
+static void encode_scalar(const unsigned char *&in, size_t &in_len, char *&out) {
+	for (; in_len >= 3; in_len -= 3, in += 3, out += 4) {
+		const uint32_t triple = (uint32_t(in[0]) << 16) | (uint32_t(in[1]) << 8) | in[2];
+		out[0] = base64_chars[(triple >> 18) & 0x3f];
+		out[1] = base64_chars[(triple >> 12) & 0x3f];
+		out[2] = base64_chars[(triple >> 6) & 0x3f];
+		out[3] = base64_chars[triple & 0x3f];
+	}
 }
 
-std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
-	std::string ret;
-	int i = 0;
-	int j = 0;
-	unsigned char char_array_3[3];
-	unsigned char char_array_4[4];
-
-	while (in_len--) {
-		char_array_3[i++] = *(bytes_to_encode++);
-		if (i == 3) {
-			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-			char_array_4[3] = char_array_3[2] & 0x3f;
-
-			for (i = 0; (i < 4); i++)
-				ret += base64_chars[char_array_4[i]];
-			i = 0;
+static void encode_tail(const unsigned char *in, const size_t &in_len, char *out) {
+	if (in_len == 0) {
+		return;
+	}
+	const uint32_t triple = (uint32_t(in[0]) << 16) | ((in_len > 1) ? (uint32_t(in[1]) << 8) : 0);
+	out[0] = base64_chars[(triple >> 18) & 0x3f];
+	out[1] = base64_chars[(triple >> 12) & 0x3f];
+	out[2] = (in_len > 1) ? base64_chars[(triple >> 6) & 0x3f] : '=';
+	out[3] = '=';
+}
+
+/* Whole quads, stops in front of the first quad holding '=' or a non-base64 character */
+static void decode_scalar(const unsigned char *&in, size_t &in_len, unsigned char *&out) {
+	for (; in_len >= 4; in_len -= 4, in += 4, out += 3) {
+		const int8_t a = base64_values.value[in[0]], b = base64_values.value[in[1]];
+		const int8_t c = base64_values.value[in[2]], d = base64_values.value[in[3]];
+		if ((a | b | c | d) < 0) {
+			break;
+		}
+		const uint32_t quad = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | uint32_t(d);
+		out[0] = static_cast<unsigned char>(quad >> 16);
+		out[1] = static_cast<unsigned char>(quad >> 8);
+		out[2] = static_cast<unsigned char>(quad);
+	}
+}
+
+/* Whatever decode_scalar left: decodes up to the first '=' or non-base64 character, a trailing partial quad yields its complete bytes */
+static void decode_tail(const unsigned char *in, size_t in_len, unsigned char *&out) {
+	uint32_t quad = 0;
+	int count = 0;
+	for (; in_len > 0; --in_len, ++in) {
+		const int8_t value = base64_values.value[*in];
+		if (value < 0) {
+			break;
+		}
+		quad = (quad << 6) | uint32_t(value);
+		if (++count == 4) {
+			*out++ = static_cast<unsigned char>(quad >> 16);
+			*out++ = static_cast<unsigned char>(quad >> 8);
+			*out++ = static_cast<unsigned char>(quad);
+			quad = 0;
+			count = 0;
+		}
+	}
+	if (count >= 2) {
+		quad <<= 6 * (4 - count);
+		*out++ = static_cast<unsigned char>(quad >> 16);
+		if (count == 3) {
+			*out++ = static_cast<unsigned char>(quad >> 8);
 		}
 	}
+}
 
-	if (i)
-	{
-		for (j = i; j < 3; j++)
-			char_array_3[j] = '\0';
 
-		char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-		char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-		char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+#ifdef BASE64_X86
+/* ================================ SSE4.1 ================================ */
+// Vector kernels after W. Mula / A. Klomp: split 3 bytes into 4 sextets with multiplies, map sextets <--> ASCII with pshufb
 
-		for (j = 0; (j < i + 1); j++)
-			ret += base64_chars[char_array_4[j]];
+BASE64_TARGET("sse4.1") static inline __m128i enc_reshuffle_sse(const __m128i &in) {
+	const __m128i shuffled = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m128i t0 = _mm_and_si128(shuffled, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(shuffled, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
 
-		while ((i++ < 3))
-			ret += '=';
+BASE64_TARGET("sse4.1") static inline __m128i enc_translate_sse(const __m128i &in) {
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	indices = _mm_sub_epi8(indices, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
 
+BASE64_TARGET("sse4.1") static void encode_sse41(const unsigned char *&in, size_t &in_len, char *&out) {
+	for (; in_len >= 16; in_len -= 12, in += 12, out += 16) {		// 12 bytes in, 16 chars out; the load reads 4 bytes ahead
+		const __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), enc_translate_sse(enc_reshuffle_sse(str)));
 	}
+}
 
-	return ret;
+BASE64_TARGET("sse4.1") static void decode_sse41(const unsigned char *&in, size_t &in_len, unsigned char *&out) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2F = _mm_set1_epi8(0x2f);
 
+	for (; in_len >= 16; in_len -= 16, in += 16, out += 12) {		// 16 chars in, 12 bytes out; the store writes 4 bytes ahead
+		__m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2F);
+		const __m128i lo_nibbles = _mm_and_si128(str, mask_2F);
+		const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+		const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+		if (!_mm_testz_si128(lo, hi)) {
+			break;							// '=' or an invalid character, the scalar path finishes from here
+		}
+		const __m128i eq_2F = _mm_cmpeq_epi8(str, mask_2F);
+		str = _mm_add_epi8(str, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2F, hi_nibbles)));
+
+		const __m128i merge_ab_and_bc = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		__m128i packed = _mm_madd_epi16(merge_ab_and_bc, _mm_set1_epi32(0x00011000));
+		packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+	}
 }
 
-std::string base64_decode(std::string const& encoded_string) {
-	size_t in_len = encoded_string.size();
-	int i = 0;
-	int j = 0;
-	int in_ = 0;
-	unsigned char char_array_4[4], char_array_3[3];
-	std::string ret;
-
-	while (in_len-- && (encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
-		char_array_4[i++] = encoded_string[in_]; in_++;
-		if (i == 4) {
-			for (i = 0; i < 4; i++)
-				char_array_4[i] = base64_chars.find(char_array_4[i]) & 0xff;
-
-			char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-			char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-			char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-			for (i = 0; (i < 3); i++)
-				ret += char_array_3[i];
-			i = 0;
+
+/* ================================ AVX2 ================================ */
+
+BASE64_TARGET("avx2") static void encode_avx2(const unsigned char *&in, size_t &in_len, char *&out) {
+	const __m256i shuffle = _mm256_set_epi8(
+		10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+		10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m256i lut = _mm256_setr_epi8(
+		65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+		65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+
+	for (; in_len >= 28; in_len -= 24, in += 24, out += 32) {		// 24 bytes in, 32 chars out; each lane loads 16 of its 12 bytes
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12));
+		__m256i str = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+		str = _mm256_shuffle_epi8(str, shuffle);
+		const __m256i t0 = _mm256_and_si256(str, _mm256_set1_epi32(0x0fc0fc00));
+		const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		const __m256i t2 = _mm256_and_si256(str, _mm256_set1_epi32(0x003f03f0));
+		const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		str = _mm256_or_si256(t1, t3);
+
+		__m256i indices = _mm256_subs_epu8(str, _mm256_set1_epi8(51));
+		indices = _mm256_sub_epi8(indices, _mm256_cmpgt_epi8(str, _mm256_set1_epi8(25)));
+		str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lut, indices));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), str);
+	}
+}
+
+BASE64_TARGET("avx2") static void decode_avx2(const unsigned char *&in, size_t &in_len, unsigned char *&out) {
+	const __m256i lut_lo = _mm256_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2F = _mm256_set1_epi8(0x2f);
+	const __m256i pack = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+	for (; in_len >= 32; in_len -= 32, in += 32, out += 24) {		// 32 chars in, 24 bytes out; the store writes 8 bytes ahead
+		__m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+		const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2F);
+		const __m256i lo_nibbles = _mm256_and_si256(str, mask_2F);
+		const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		if (!_mm256_testz_si256(lo, hi)) {
+			break;
 		}
+		const __m256i eq_2F = _mm256_cmpeq_epi8(str, mask_2F);
+		str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2F, hi_nibbles)));
+
+		const __m256i merge_ab_and_bc = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		__m256i packed = _mm256_madd_epi16(merge_ab_and_bc, _mm256_set1_epi32(0x00011000));
+		packed = _mm256_shuffle_epi8(packed, pack);
+		packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
 	}
+}
+#endif	// BASE64_X86
 
-	if (i) {
-		for (j = 0; j < i; j++)
-			char_array_4[j] = base64_chars.find(char_array_4[j]) & 0xff;
 
-		char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-		char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+/* ================================ DISPATCH ================================ */
 
-		for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
+typedef void(*EncodeKernel)(const unsigned char *&, size_t &, char *&);
+typedef void(*DecodeKernel)(const unsigned char *&, size_t &, unsigned char *&);
+
+struct Base64Kernels {
+	EncodeKernel encode;
+	DecodeKernel decode;
+};
+
+static constexpr size_t decodeStoreSlack{ 8 };		/* Bytes a vector store may write past the decoded data */
+
+static Base64Kernels selectKernels(void) {
+#ifdef BASE64_X86
+	unsigned int ecx1 = 0;				// CPUID.1:ECX
+	unsigned int ebx7 = 0;				// CPUID.7.0:EBX
+	unsigned long long xcr0 = 0;
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	ecx1 = info[2];
+	if (maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		ebx7 = info[1];
+	}
+	if (ecx1 & (1u << 27)) {			// OSXSAVE
+		xcr0 = _xgetbv(0);
+	}
+#else
+	unsigned int eax, ebx, ecx, edx;
+	const unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		ecx1 = ecx;
+	}
+	if (maxLeaf >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		ebx7 = ebx;
 	}
+	if (ecx1 & (1u << 27)) {			// OSXSAVE
+		unsigned int xcr0_lo, xcr0_hi;
+		__asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+		xcr0 = (static_cast<unsigned long long>(xcr0_hi) << 32) | xcr0_lo;
+	}
+#endif
+	const bool osSavesYmm = (xcr0 & 0x6) == 0x6;
+	if (osSavesYmm && (ecx1 & (1u << 28)) && (ebx7 & (1u << 5))) {		// AVX, AVX2
+		return { encode_avx2, decode_avx2 };
+	}
+	if (ecx1 & (1u << 19)) {			// SSE4.1
+		return { encode_sse41, decode_sse41 };
+	}
+#endif
+	return { encode_scalar, decode_scalar };
+}
 
+static const Base64Kernels& kernels(void) {
+	static const Base64Kernels selected = selectKernels();
+	return selected;
+}
+
+
+/* ================================ PUBLIC APIs ================================ */
+
+std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
+	std::string ret((static_cast<size_t>(in_len) + 2) / 3 * 4, '\0');
+	const unsigned char *in = bytes_to_encode;
+	size_t remaining = in_len;
+	char *out = &ret[0];
+	kernels().encode(in, remaining, out);
+	encode_scalar(in, remaining, out);
+	encode_tail(in, remaining, out);
+	return ret;
+}
+
+std::string base64_decode(std::string const& encoded_string) {
+	std::string ret(encoded_string.size() / 4 * 3 + 3 + decodeStoreSlack, '\0');
+	const unsigned char *in = reinterpret_cast<const unsigned char*>(encoded_string.data());
+	size_t remaining = encoded_string.size();
+	unsigned char *begin = reinterpret_cast<unsigned char*>(&ret[0]);
+	unsigned char *out = begin;
+	kernels().decode(in, remaining, out);
+	decode_scalar(in, remaining, out);
+	decode_tail(in, remaining, out);
+	ret.resize(out - begin);
 	return ret;
 }
+
+size_t base64_decoded_length(std::string const& encoded_string) {
+	size_t length = encoded_string.size();
+	while (length > 0 && encoded_string[length - 1] == '=') {
+		--length;
+	}
+	return length / 4 * 3 + ((length % 4 > 1) ? length % 4 - 1 : 0);
+}
+
+
+/* ================================ STREAMING ================================ */
+
+Base64StreamEncoder::Base64StreamEncoder(const Base64Sink &sink, const size_t &chunkSize) :
+	sink(sink), buffer((chunkSize < 4) ? 4 : chunkSize / 4 * 4, '\0'), used(0), carryLength(0), failed(false) {}
+
+bool Base64StreamEncoder::flush(void) {
+	if (used > 0 && !failed) {
+		failed = !sink(buffer.data(), used);
+	}
+	used = 0;
+	return !failed;
+}
+
+bool Base64StreamEncoder::update(const void *data, size_t length) {
+	const unsigned char *in = static_cast<const unsigned char*>(data);
+	while (carryLength > 0 && carryLength < 3 && length > 0) {		// Complete the group left over by the previous chunk
+		carry[carryLength++] = *in++;
+		--length;
+	}
+	if (carryLength == 3) {
+		if (used + 4 > buffer.size() && !flush()) {
+			return false;
+		}
+		const unsigned char *group = carry;
+		size_t groupLength = 3;
+		char *out = &buffer[used];
+		encode_scalar(group, groupLength, out);
+		used += 4;
+		carryLength = 0;
+	}
+	while (length >= 3 && !failed) {
+		const size_t room = (buffer.size() - used) / 4;				// Groups that fit in the buffer
+		if (room == 0) {
+			flush();
+			continue;
+		}
+		size_t sliceLength = ((length / 3 < room) ? length / 3 : room) * 3;
+		length -= sliceLength;
+		char *out = &buffer[used];
+		kernels().encode(in, sliceLength, out);
+		encode_scalar(in, sliceLength, out);
+		used = out - buffer.data();
+	}
+	for (; length > 0; --length) {
+		carry[carryLength++] = *in++;
+	}
+	return !failed;
+}
+
+bool Base64StreamEncoder::finish(void) {
+	if (carryLength > 0) {
+		if (used + 4 > buffer.size() && !flush()) {
+			return false;
+		}
+		encode_tail(carry, carryLength, &buffer[used]);
+		used += 4;
+		carryLength = 0;
+	}
+	return flush();
+}
+
+Base64StreamDecoder::Base64StreamDecoder(const Base64Sink &sink, const size_t &chunkSize) :
+	sink(sink), buffer(((chunkSize < 3) ? 3 : chunkSize) + decodeStoreSlack, '\0'), used(0), carryLength(0), ended(false), failed(false) {}
+
+bool Base64StreamDecoder::flush(void) {
+	if (used > 0 && !failed) {
+		failed = !sink(buffer.data(), used);
+	}
+	used = 0;
+	return !failed;
+}
+
+bool Base64StreamDecoder::update(const char *data, size_t length) {
+	const unsigned char *in = reinterpret_cast<const unsigned char*>(data);
+	if (ended || failed) {
+		return !failed;											// Anything past '=' or an invalid character is ignored
+	}
+	while (carryLength > 0 && carryLength < 4 && length > 0) {
+		carry[carryLength++] = *in++;
+		--length;
+	}
+	if (carryLength == 4) {
+		if (used + 3 + decodeStoreSlack > buffer.size() && !flush()) {
+			return false;
+		}
+		const unsigned char *quad = carry;
+		size_t quadLength = 4;
+		unsigned char *begin = reinterpret_cast<unsigned char*>(&buffer[0]);
+		unsigned char *out = begin + used;
+		decode_scalar(quad, quadLength, out);
+		decode_tail(quad, quadLength, out);
+		used = out - begin;
+		carryLength = 0;
+		ended = (quadLength > 0);
+	}
+	while (length >= 4 && !ended && !failed) {
+		const size_t room = (buffer.size() - decodeStoreSlack - used) / 3;	// Quads that fit in the buffer
+		if (room == 0) {
+			flush();
+			continue;
+		}
+		size_t sliceLength = ((length / 4 < room) ? length / 4 : room) * 4;
+		length -= sliceLength;
+		unsigned char *begin = reinterpret_cast<unsigned char*>(&buffer[0]);
+		unsigned char *out = begin + used;
+		kernels().decode(in, sliceLength, out);
+		decode_scalar(in, sliceLength, out);
+		if (sliceLength > 0) {									// Stopped in front of '=' or an invalid character
+			decode_tail(in, sliceLength, out);
+			ended = true;
+		}
+		used = out - begin;
+	}
+	for (; length > 0 && !ended; --length) {
+		carry[carryLength++] = *in++;
+	}
+	return !failed;
+}
+
+bool Base64StreamDecoder::finish(void) {
+	if (carryLength > 0 && !ended) {
+		unsigned char *begin = reinterpret_cast<unsigned char*>(&buffer[0]);
+		unsigned char *out = begin + used;
+		decode_tail(carry, carryLength, out);
+		used = out - begin;
+	}
+	carryLength = 0;
+	ended = true;
+	return flush();
+}
@@ -0,0 +1,214 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "httpResponseParser.h"
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+
+static constexpr size_t maxLineLength{ 64 * 1024 };		/* Guard against a peer streaming an endless header */
+static constexpr size_t maxBodyReserve{ 1024 * 1024 };	/* Content-Length is the peer's claim, a larger body grows as it arrives */
+
+static std::string toLower(std::string str) {
+	for (auto &c : str) {
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return str;
+}
+
+static std::string trim(const std::string &str) {
+	const size_t first = str.find_first_not_of(" \t");
+	if (first == std::string::npos) {
+		return std::string();
+	}
+	const size_t last = str.find_last_not_of(" \t");
+	return str.substr(first, last - first + 1);
+}
+
+std::string HttpResponse::header(const std::string &lowerCaseName) const {
+	for (const auto &field : headers) {
+		if (field.first == lowerCaseName) {
+			return field.second;
+		}
+	}
+	return std::string();
+}
+
+/* ================================ PRIVATE ================================ */
+
+bool HttpResponseParser::readLine(const char *&data, const char *end) {
+	const char *newLine = static_cast<const char*>(std::memchr(data, '\n', end - data));
+	const char *lineEnd = newLine ? newLine : end;
+	line.append(data, lineEnd);
+	data = newLine ? newLine + 1 : end;
+	if (line.length() > maxLineLength) {
+		state = State::Error;
+		return false;
+	}
+	if (!newLine) {
+		return false;				/* Wait for more data */
+	}
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+	return true;
+}
+
+void HttpResponseParser::parseStatusLine(void) {
+	// HTTP/1.1 200 OK
+	if (line.compare(0, 5, "HTTP/") != 0 || line.length() < 12) {
+		state = State::Error;
+		return;
+	}
+	response.keepAlive = (line.compare(5, 3, "1.0") != 0);	/* HTTP/1.1 defaults to persistent connections */
+	response.statusCode = std::atoi(line.c_str() + 9);
+	state = State::Headers;
+}
+
+void HttpResponseParser::parseHeaderLine(void) {
+	const size_t colon = line.find(':');
+	if (colon == std::string::npos) {
+		state = State::Error;
+		return;
+	}
+	response.headers.emplace_back(toLower(trim(line.substr(0, colon))), trim(line.substr(colon + 1)));
+}
+
+void HttpResponseParser::onHeadersComplete(void) {
+	if (response.statusCode / 100 == 1) {				/* Interim response (i.e. 100 Continue), the real one follows */
+		response = HttpResponse();
+		state = State::StatusLine;
+		return;
+	}
+	const std::string connection = toLower(response.header("connection"));
+	if (connection.find("close") != std::string::npos) {
+		response.keepAlive = false;
+	}
+	else if (connection.find("keep-alive") != std::string::npos) {
+		response.keepAlive = true;
+	}
+	if (response.statusCode == 204 || response.statusCode == 304) {
+		state = State::Complete;
+	}
+	else if (toLower(response.header("transfer-encoding")).find("chunked") != std::string::npos) {
+		state = State::ChunkSize;
+	}
+	else if (!response.header("content-length").empty()) {
+		const std::string contentLength = response.header("content-length");
+		char *end = nullptr;
+		errno = 0;
+		bytesRemaining = std::strtoull(contentLength.c_str(), &end, 10);
+		if (!std::isdigit(static_cast<unsigned char>(contentLength[0])) || *end != '\0' || errno == ERANGE) {
+			state = State::Error;						/* No way to tell where this body ends, the connection can't be reused */
+			return;
+		}
+		response.body.reserve((bytesRemaining < maxBodyReserve) ? bytesRemaining : maxBodyReserve);
+		state = (bytesRemaining == 0) ? State::Complete : State::Body;
+	}
+	else {
+		response.keepAlive = false;						/* Body is delimited by the peer closing the connection */
+		state = State::BodyUntilClose;
+	}
+}
+
+void HttpResponseParser::parseChunkSize(void) {
+	char *end = nullptr;
+	bytesRemaining = std::strtoull(line.c_str(), &end, 16);		/* Chunk extensions after ';' are ignored */
+	if (end == line.c_str()) {
+		state = State::Error;
+		return;
+	}
+	state = (bytesRemaining == 0) ? State::Trailers : State::ChunkData;
+}
+
+/* ================================ PUBLIC APIs ================================ */
+
+void HttpResponseParser::reset(void) {
+	state = State::StatusLine;
+	line.clear();
+	bytesRemaining = 0;
+	response = HttpResponse();
+}
+
+size_t HttpResponseParser::feed(const char *data, size_t length) {
+	const char *begin = data;
+	const char *end = data + length;
+
+	while (data < end && state != State::Complete && state != State::Error) {
+		switch (state) {
+		case State::StatusLine:
+		case State::Headers:
+		case State::ChunkSize:
+		case State::ChunkDataEnd:
+		case State::Trailers:
+			if (!readLine(data, end)) {
+				break;
+			}
+			if (state == State::StatusLine) {
+				if (!line.empty()) {		/* Tolerate empty lines before the status line */
+					parseStatusLine();
+				}
+			}
+			else if (state == State::Headers) {
+				if (line.empty()) { onHeadersComplete(); }
+				else { parseHeaderLine(); }
+			}
+			else if (state == State::ChunkSize) {
+				parseChunkSize();
+			}
+			else if (state == State::ChunkDataEnd) {
+				state = line.empty() ? State::ChunkSize : State::Error;
+			}
+			else if (line.empty()) {		/* Trailers end with an empty line */
+				state = State::Complete;
+			}
+			line.clear();
+			break;
+		case State::Body:
+		case State::ChunkData: {
+			const size_t bytesToCopy = (static_cast<size_t>(end - data) < bytesRemaining) ? static_cast<size_t>(end - data) : bytesRemaining;
+			response.body.append(data, bytesToCopy);
+			data += bytesToCopy;
+			bytesRemaining -= bytesToCopy;
+			if (bytesRemaining == 0) {
+				state = (state == State::Body) ? State::Complete : State::ChunkDataEnd;
+			}
+			break;
+		}
+		case State::BodyUntilClose:
+			response.body.append(data, end);
+			data = end;
+			break;
+		default:
+			break;
+		}
+	}
+	return static_cast<size_t>(data - begin);
+}
+
+void HttpResponseParser::finish(void) {
+	if (state == State::BodyUntilClose) {
+		state = State::Complete;
+	}
+	else if (state != State::Complete) {
+		state = State::Error;			/* Connection dropped in the middle of the message */
+	}
+}
@@ -0,0 +1,52 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "job.h"
+#include "json.h"
+#include "stringUtil.h"
+
+bool Job::parseAll(const std::string &utf8JsonData, std::vector<Job> &jobs) {
+	std::vector<std::unordered_map<std::string, std::string>> requests;
+	if (!JsonUtil::extractStringMembersOfEach(utf8JsonData, requests)) {
+		return false;
+	}
+	jobs.reserve(jobs.size() + requests.size());
+	for (auto &request : requests) {
+		jobs.emplace_back();
+		jobs.back().fields = std::move(request);
+		jobs.back().jobMode = jobs.back().value("mode");
+	}
+	return true;
+}
+
+const std::wstring& Job::mode(void) const {
+	return jobMode;
+}
+
+std::wstring Job::value(const std::string &key) const {
+	const auto field = fields.find(key);
+	return (field == fields.end()) ? std::wstring() : StringUtils::s2ws(field->second);
+}
+
+const std::string& Job::valueUtf8(const std::string &key) const {
+	static const std::string empty;
+	const auto field = fields.find(key);
+	return (field == fields.end()) ? empty : field->second;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "jobExecutor.h"
+#include <iostream>
+
+JobExecutor::JobExecutor(const size_t &ioHeavyWorkers, const size_t &lightWorkers, const size_t &queueCapacityPerLane) :
+	queueCapacity(queueCapacityPerLane), stopping(false) {
+
+	Lane &ioHeavyLane = lanes[static_cast<unsigned int>(JobLane::IoHeavy)];
+	Lane &lightLane = lanes[static_cast<unsigned int>(JobLane::Light)];
+	for (size_t i = 0; i < ioHeavyWorkers; ++i) {
+		ioHeavyLane.workers.emplace_back(&JobExecutor::worker, this, std::ref(ioHeavyLane));
+	}
+	for (size_t i = 0; i < lightWorkers; ++i) {
+		lightLane.workers.emplace_back(&JobExecutor::worker, this, std::ref(lightLane));
+	}
+}
+
+void JobExecutor::worker(Lane &lane) {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(lanesMutex);
+			lane.taskAvailable.wait(lock, [&] { return stopping || !lane.tasks.empty(); });
+			if (lane.tasks.empty()) {
+				return;				// Stopping and nothing left to run
+			}
+			task = std::move(lane.tasks.front());
+			lane.tasks.pop();
+		}
+		try {
+			task();
+		}
+		catch (const std::exception &e) {		// A failing job must not take a worker down with it
+			std::cerr << "job failed: " << e.what() << std::endl;
+		}
+	}
+}
+
+bool JobExecutor::submit(const JobLane &lane, std::function<void()> task) {
+	Lane &target = lanes[static_cast<unsigned int>(lane)];
+	{
+		std::lock_guard<std::mutex> lock(lanesMutex);
+		if (stopping || target.tasks.size() >= queueCapacity) {
+			return false;
+		}
+		target.tasks.push(std::move(task));
+	}
+	target.taskAvailable.notify_one();
+	return true;
+}
+
+void JobExecutor::shutdown(void) {
+	{
+		std::lock_guard<std::mutex> lock(lanesMutex);
+		stopping = true;
+	}
+	for (auto &lane : lanes) {
+		lane.taskAvailable.notify_all();
+		for (auto &worker : lane.workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+		lane.workers.clear();
+	}
+}
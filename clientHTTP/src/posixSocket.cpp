@@ -0,0 +1,201 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "tcpNetworkManager.h"	/* Always use this header at the top */
+
+#ifndef _WIN32
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+
+
+namespace mysocket {
+	/* WakeEvent */
+	WakeEvent::WakeEvent() : event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+		if (event_fd == -1) {
+			std::cerr << "eventfd() failed with errno : " << errno << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	WakeEvent::~WakeEvent() {
+		close(event_fd);
+	}
+	void WakeEvent::signal(void) {
+		const uint64_t increment = 1;
+		(void)!write(event_fd, &increment, sizeof(increment));		// Only fails if the counter would overflow, it is already signaled then
+	}
+	void WakeEvent::reset(void) {
+		uint64_t counter;
+		(void)!read(event_fd, &counter, sizeof(counter));			// EAGAIN if it wasn't signaled
+	}
+
+	/* Private functions */
+	int PosixSocket::waitFor(const uint32_t &events, const int &timeout_ms) {
+		if (registeredEvents != events) {
+			struct epoll_event event = {};
+			event.events = events;
+			event.data.fd = http_socket;
+			if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, http_socket, &event) == -1) {
+				return -1;
+			}
+			registeredEvents = events;
+		}
+		struct epoll_event ready = {};
+		int result;
+		do {
+			result = epoll_wait(epoll_fd, &ready, 1, timeout_ms);
+		} while (result == -1 && errno == EINTR);
+		return result;
+	}
+	int PosixSocket::waitForReadable(const struct timeval &timeout) {
+		return waitFor(EPOLLIN, static_cast<int>(timeout.tv_sec * 1000 + timeout.tv_usec / 1000));
+	}
+	int PosixSocket::waitForReadableOrWake(const struct timeval &timeout, const WakeEvent &wake) {
+		// poll() rather than the epoll set, a signaled event must not wake the waits inside connect()/transmit()
+		struct pollfd fds[2] = { { http_socket, POLLIN, 0 }, { wake.handle(), POLLIN, 0 } };
+		const int timeout_ms = static_cast<int>(timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+		int result;
+		do {
+			result = poll(fds, 2, timeout_ms);
+		} while (result == -1 && errno == EINTR);
+		if (result <= 0) {
+			return result;
+		}
+		return (fds[0].revents != 0) ? 1 : 0;
+	}
+	long PosixSocket::receiveSome(char *buffer, const size_t &length) {
+		while (true) {
+			const ssize_t bytesRead = recv(http_socket, buffer, length, 0);
+			if (bytesRead >= 0) {
+				return static_cast<long>(bytesRead);
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitFor(EPOLLIN, ioTimeout_ms) > 0) {
+				continue;		// Spurious wake-up, the data is on its way
+			}
+			return -1;
+		}
+	}
+
+	/* API's */
+	void PosixSocket::socket_init(void) {
+		epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd == -1) {
+			std::cerr << "epoll_create1() failed with errno : " << errno << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		sockaddr_in.sin_family = AF_INET;
+	}
+	void PosixSocket::connect(const std::string &url, const std::string &port) {
+		if (connectionBehaviour == ConnectionBehaviour::KeepAlive && isPeerConnectionAlive()) {
+			return;				// Reuse the established connection
+		}
+		if (isConnected()) {
+			socket_close();		// Peer dropped the previous connection, reconnect transparently
+		}
+		http_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+		if (http_socket == -1) {
+			std::cerr << "socket() failed with errno : " << errno << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		struct epoll_event event = {};
+		event.events = registeredEvents = EPOLLOUT;
+		event.data.fd = http_socket;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, http_socket, &event);
+
+		sockaddr_in.sin_port = htons(static_cast<uint16_t>(std::stoi(port)));
+		inet_pton(AF_INET, url.c_str(), &sockaddr_in.sin_addr);
+		if (::connect(http_socket, (struct sockaddr*)&sockaddr_in, sizeof(sockaddr_in)) == 0) {
+			return;
+		}
+		int socketError = errno;
+		if (socketError == EINPROGRESS && waitFor(EPOLLOUT, ioTimeout_ms) > 0) {
+			socklen_t optionLength = sizeof(socketError);
+			getsockopt(http_socket, SOL_SOCKET, SO_ERROR, &socketError, &optionLength);
+		}
+		if (socketError != 0) {
+			socket_close();
+		}
+	}
+	bool PosixSocket::transmit(std::initializer_list<ConstBuffer> buffers) {
+		if (!isConnected()) {
+			return false;
+		}
+		std::vector<struct iovec> ioBuffers;
+		ioBuffers.reserve(buffers.size());
+		for (const auto &buffer : buffers) {
+			if (buffer.length != 0) {
+				ioBuffers.push_back({ const_cast<char*>(buffer.data), buffer.length });
+			}
+		}
+		size_t first = 0;
+		while (first < ioBuffers.size()) {            // send data to server
+			struct msghdr message = {};
+			message.msg_iov = &ioBuffers[first];
+			message.msg_iovlen = ioBuffers.size() - first;
+			// sendmsg() is writev() with flags, MSG_NOSIGNAL keeps a dropped connection from raising SIGPIPE
+			ssize_t nbytes_last = sendmsg(http_socket, &message, MSG_NOSIGNAL);
+			if (nbytes_last == -1) {
+				if (errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && waitFor(EPOLLOUT, ioTimeout_ms) > 0)) {
+					continue;
+				}
+				socket_close();
+				return false;
+			}
+			while (nbytes_last != 0) {				// Skip what was sent, resume from a partially sent buffer
+				const size_t consumed = (static_cast<size_t>(nbytes_last) < ioBuffers[first].iov_len) ? static_cast<size_t>(nbytes_last) : ioBuffers[first].iov_len;
+				ioBuffers[first].iov_base = static_cast<char*>(ioBuffers[first].iov_base) + consumed;
+				ioBuffers[first].iov_len -= consumed;
+				nbytes_last -= static_cast<ssize_t>(consumed);
+				if (ioBuffers[first].iov_len == 0) {
+					++first;
+				}
+			}
+		}
+		return true;
+	}
+	bool PosixSocket::isConnected(void) {
+		return http_socket != -1;
+	}
+	void PosixSocket::socket_close() {
+		if (http_socket != -1) {
+			close(http_socket);			// Also removes it from the epoll set
+		}
+		http_socket = -1;
+		registeredEvents = 0;
+	}
+	void PosixSocket::socket_cleanup() {
+		socket_close();
+		if (epoll_fd != -1) {
+			close(epoll_fd);
+		}
+		epoll_fd = -1;
+	}
+}
+
+#endif
@@ -0,0 +1,110 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "replyEnvelope.h"
+#include "base64.h"
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include <cstring>
+
+namespace {
+
+	// rapidjson output stream feeding a Base64StreamEncoder, Put() is per character so input is staged in blocks
+	class Base64OutputStream {
+
+	private:
+		Base64StreamEncoder &encoder;
+		char block[12 * 1024];
+		size_t used;
+
+	public:
+		typedef char Ch;
+		explicit Base64OutputStream(Base64StreamEncoder &encoder) : encoder(encoder), used(0) {}
+
+		void Put(const Ch c) {
+			if (used == sizeof(block)) {
+				Flush();
+			}
+			block[used++] = c;
+		}
+
+		void write(const char *data, size_t length) {
+			while (length) {
+				if (used == sizeof(block)) {
+					Flush();
+				}
+				const size_t n = (length < sizeof(block) - used) ? length : sizeof(block) - used;
+				std::memcpy(block + used, data, n);
+				used += n;
+				data += n;
+				length -= n;
+			}
+		}
+
+		void Flush(void) {
+			encoder.update(block, used);
+			used = 0;
+		}
+	};
+
+	// Escaped, quoted JSON string, a string is a valid root value so no enclosing object is needed
+	void writeJsonString(Base64OutputStream &stream, const std::string &value) {
+		rapidjson::Writer<Base64OutputStream> writer(stream);
+		writer.String(value.data(), static_cast<rapidjson::SizeType>(value.length()));
+	}
+}
+
+ReplyEnvelope::ReplyEnvelope(const std::string &utf8SysInfoJson) : prefix("{"), hasMembers(false) {
+	rapidjson::Document document;
+	document.Parse(utf8SysInfoJson.c_str(), utf8SysInfoJson.length());
+	if (!document.IsObject()) {
+		return;							// Replies still go out, just without the system information
+	}
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	document.Accept(writer);
+	prefix.assign(buffer.GetString(), buffer.GetSize() - 1);		// Drop the closing '}'
+	hasMembers = !document.ObjectEmpty();
+}
+
+std::string ReplyEnvelope::encode(const std::string &replyType, const std::string &data) const {
+	// Escaping only grows the JSON, so this is a lower bound that avoids most reallocations
+	const size_t jsonLength = prefix.length() + replyType.length() + data.length() + 8;
+	std::string encoded;
+	encoded.reserve((jsonLength + 2) / 3 * 4);
+
+	Base64StreamEncoder encoder([&encoded](const char *chunk, const size_t &length) {
+		encoded.append(chunk, length);
+		return true;
+	});
+	Base64OutputStream stream(encoder);
+	stream.write(prefix.data(), prefix.length());
+	if (hasMembers) {
+		stream.Put(',');
+	}
+	writeJsonString(stream, replyType);
+	stream.Put(':');
+	writeJsonString(stream, data);
+	stream.Put('}');
+	stream.Flush();
+	encoder.finish();
+	return encoded;
+}
@@ -20,62 +20,129 @@
 
 
 #include "sharedResourceManager.h"
+#include "utilities.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
 
-void SharedResourceManager::pushResponse(const std::wstring &response) {
-	std::lock_guard<std::mutex> lock(responseQueueMutex);
-	if (! (response.empty()) ) {
-		responseQueue.push(response);
+namespace fs = std::filesystem;
+
+SharedResourceManager::SharedResourceManager(const size_t &memoryBudget, const size_t &highWaterMark) :
+	memoryBudget(memoryBudget), highWaterMark(highWaterMark), memoryBytes(0), spilledBytes(0), spillCount(0) {
+}
+
+SharedResourceManager::~SharedResourceManager() {
+	QueuedResponse response;
+	std::error_code ec;
+	while (responseQueue.pop(response)) {
+		if (!response.spillFile.empty()) {
+			fs::remove(response.spillFile, ec);
+		}
+	}
+	if (!spillDir.empty()) {
+		fs::remove_all(spillDir, ec);
 	}
 }
 
-std::wstring SharedResourceManager::popResponse(void) {
-	std::lock_guard<std::mutex> lock(responseQueueMutex);
-	std::wstring response;
-	if(! (responseQueue.empty()) ){
-		response = responseQueue.front();
-		responseQueue.pop();
+/* Move the body out to a file in a private temp directory, false (body untouched) if it can't be written */
+bool SharedResourceManager::spill(QueuedResponse &response) {
+	// Job results may hold anything the agent read, keep them away from other accounts on the machine
+	std::call_once(spillDirOnce, [this] { spillDir = createPrivateTempDirectory(L"clienthttp-spill-"); });
+	if (spillDir.empty()) {
+		return false;
 	}
-	return response;
+	const long long seed = std::chrono::steady_clock::now().time_since_epoch().count();
+	const fs::path spillFile = spillDir / (generateRandomAlphanumeric(8, seed + spillCount++) + "-response");
+	if (!writeNewPrivateFile(spillFile, response.body)) {
+		return false;
+	}
+	response.spillFile = spillFile;
+	std::string().swap(response.body);			// Release the memory, clear() would keep it
+	return true;
 }
 
-void SharedResourceManager::pushJob(const std::wstring &job) {
-	std::lock_guard<std::mutex> lock(jobQueueMutex);
-	if (! (job.empty()) ) {
-		jobQueue.push(job);
+void SharedResourceManager::pushResponse(std::string &&response) {
+	if (response.empty()) {
+		return;
+	}
+	QueuedResponse queued;
+	queued.length = response.length();
+	queued.body = std::move(response);
+	// Reserve first so concurrent producers can't overshoot the budget together
+	if (memoryBytes.fetch_add(queued.length) + queued.length > memoryBudget) {
+		memoryBytes.fetch_sub(queued.length);
+		if (spill(queued)) {
+			spilledBytes.fetch_add(queued.length);
+		}
+		else {
+			memoryBytes.fetch_add(queued.length);	// Disk is unavailable, keeping it beats losing a job result
+		}
 	}
+	responseQueue.push(std::move(queued));
+	responseEvent.signal();
 }
 
-std::wstring SharedResourceManager::popJob(void) {
-	std::lock_guard<std::mutex> lock(jobQueueMutex);
-	std::wstring job;
-	if ( !(jobQueue.empty()) ) {
-		job = jobQueue.front();
-		jobQueue.pop();
+bool SharedResourceManager::popResponse(std::string &response) {
+	QueuedResponse queued;
+	while (responseQueue.pop(queued)) {
+		if (queued.spillFile.empty()) {
+			memoryBytes.fetch_sub(queued.length);
+			response = std::move(queued.body);
+			return true;
+		}
+		spilledBytes.fetch_sub(queued.length);
+		std::ifstream file(queued.spillFile, std::ios::binary);
+		response.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		file.close();
+		std::error_code ec;
+		fs::remove(queued.spillFile, ec);
+		if (response.length() == queued.length) {
+			return true;
+		}
+		std::cerr << "Lost a spilled job result, " << queued.spillFile.string() << " couldn't be read back" << std::endl;
 	}
-	return job;
+	return false;
+}
+
+size_t SharedResourceManager::peekResponseLength(void) {
+	const QueuedResponse *next = responseQueue.front();
+	return (next != nullptr) ? next->length : 0;
 }
 
-void SharedResourceManager::setSysInfoInJson(const std::wstring &sysInfo) {
+size_t SharedResourceManager::pendingResponseBytes(void) {
+	return memoryBytes.load() + spilledBytes.load();
+}
+
+bool SharedResourceManager::isResponseBacklogged(void) {
+	return pendingResponseBytes() > highWaterMark;
+}
+
+mysocket::WakeEvent& SharedResourceManager::getResponseEvent(void) {
+	return responseEvent;
+}
+
+void SharedResourceManager::setSysInfoInJson(const std::string &sysInfo) {
 	std::lock_guard<std::mutex> lock(jsonSysInfoMutex);
 	jsonSysInfo = sysInfo;
+	replyEnvelope = std::make_shared<const ReplyEnvelope>(sysInfo);
 }
 
-std::wstring SharedResourceManager::getSysInfoInJson(void) {
+std::string SharedResourceManager::getSysInfoInJson(void) {
 	std::lock_guard<std::mutex> lock(jsonSysInfoMutex);
 	return jsonSysInfo;
 }
 
-bool SharedResourceManager::isResponseAvailable(void) {	
-	std::lock_guard<std::mutex> lock(responseQueueMutex);
-	return !responseQueue.empty();
+std::shared_ptr<const ReplyEnvelope> SharedResourceManager::getReplyEnvelope(void) {
+	std::lock_guard<std::mutex> lock(jsonSysInfoMutex);
+	return replyEnvelope;
 }
 
-void SharedResourceManager::setServerUrl(const std::wstring &url) {
+void SharedResourceManager::setServerUrl(const std::string &url) {
 	std::lock_guard<std::mutex> lock(serverUrlMutex);
 	serverUrl = url;
 }
 
-std::wstring SharedResourceManager::getServerUrl(void) {
+std::string SharedResourceManager::getServerUrl(void) {
 	std::lock_guard<std::mutex> lock(serverUrlMutex);
 	return serverUrl;
 }
\ No newline at end of file
@@ -21,10 +21,18 @@
 
 #include "systemInformation.h"
 #include <vector>
+#ifdef _WIN32
 #include <Windows.h>
 #include <lmcons.h>
+#else
+#include "stringUtil.h"
+#include <unistd.h>
+#include <pwd.h>
+#include <climits>
+#endif
 
 
+#ifdef _WIN32
 std::wstring SysInformation::getComputerName() {
 	wchar_t buffer[MAX_COMPUTERNAME_LENGTH + 1];
 	DWORD size = sizeof(buffer) / sizeof(buffer[0]);
@@ -48,3 +56,26 @@ std::wstring SysInformation::getUserName() {
 		return L""; // Return empty string if there's an error
 	}
 }
+#else
+std::wstring SysInformation::getComputerName() {
+	char buffer[HOST_NAME_MAX + 1] = {};
+
+	if (gethostname(buffer, sizeof(buffer) - 1) == 0) {
+		return StringUtils::s2ws(buffer);
+	}
+	else {
+		return L""; // Return empty string if there's an error
+	}
+}
+
+std::wstring SysInformation::getUserName() {
+	const struct passwd *pw = getpwuid(geteuid());
+
+	if (pw != nullptr) {
+		return StringUtils::s2ws(pw->pw_name);
+	}
+	else {
+		return L""; // Return empty string if there's an error
+	}
+}
+#endif
@@ -20,34 +20,122 @@
 
 #include "tcpNetworkManager.h"	/* Always use this header at the top */
 #include <string>
-#include <codecvt>
 
 
-
-std::wstring s2ws(const std::string& str) {
-
-	using convert_typeX = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_typeX, wchar_t> converterX;
-
-	try { return converterX.from_bytes(str); }
-	catch (const std::range_error& e) { return converterX.from_bytes(e.what()); }
+namespace mysocket {
+	/* Transport: platform independent part */
+	bool Transport::isPeerConnectionAlive(void) {
+		if (!isConnected()) {
+			return false;
+		}
+		// An idle keep-alive connection must have nothing to read; readability means FIN, RST or stray bytes
+		const struct timeval noWait = { 0, 0 };
+		return waitForReadable(noWait) == 0;
+	}
+	void Transport::drainUntilPeerDropsConnection(const struct timeval &timeout) {
+		while (isConnected()) {
+			if (waitForReadable(timeout) <= 0 || receiveSome(receiveBuffer.data(), receiveBuffer.size()) <= 0) {
+				socket_close();
+			}
+		}
+	}
+	void Transport::setConnectionBehaviour(const ConnectionBehaviour &behaviour) {
+		connectionBehaviour = behaviour;
+	}
+	bool Transport::waitForResponse(const struct timeval &timeout, const WakeEvent &wake) {
+		return !isConnected() || waitForReadableOrWake(timeout, wake) != 0;		// A failure is left for receiveResponse() to report
+	}
+	bool Transport::receiveResponse(HttpResponse &response, const struct timeval &timeout) {
+		if (!isConnected()) {
+			return false;
+		}
+		responseParser.reset();
+		while (!responseParser.isComplete()) {
+			if (waitForReadable(timeout) <= 0) {
+				// Wait failed or no data received within timeout
+				socket_close();
+				return false;
+			}
+			const long bytesRead = receiveSome(receiveBuffer.data(), receiveBuffer.size());
+			if (bytesRead == 0) {				// Peer closed the connection, this may also terminate the body
+				responseParser.finish();
+				socket_close();
+				break;
+			}
+			if (bytesRead < 0) {
+				socket_close();
+				return false;
+			}
+			const size_t bytesConsumed = responseParser.feed(receiveBuffer.data(), static_cast<size_t>(bytesRead));
+			if (responseParser.hasError()) {
+				socket_close();
+				return false;
+			}
+			if (bytesConsumed < static_cast<size_t>(bytesRead)) {
+				socket_close();					// Unsolicited bytes after the response, the connection is out of sync
+			}
+		}
+		if (!responseParser.isComplete()) {
+			return false;
+		}
+		response = std::move(responseParser.getResponse());
+		if (connectionBehaviour == ConnectionBehaviour::WaitForPeerToDropConnection) {
+			drainUntilPeerDropsConnection(timeout);
+		}
+		else if (!response.keepAlive) {
+			socket_close();
+		}
+		return true;
+	}
 }
 
-std::string ws2s(const std::wstring& wstr) {
-
-	using convert_typeX = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_typeX, wchar_t> converterX;
-
-	try { return converterX.to_bytes(wstr); }
-	catch (const std::range_error& e) { return e.what(); }
-}
 
+#ifdef _WIN32
 
 namespace mysocket {
+	/* WakeEvent */
+	WakeEvent::WakeEvent() : event(WSACreateEvent()) {}
+	WakeEvent::~WakeEvent() {
+		WSACloseEvent(event);
+	}
+	void WakeEvent::signal(void) {
+		WSASetEvent(event);
+	}
+	void WakeEvent::reset(void) {
+		WSAResetEvent(event);
+	}
+
 	/* Private functions */
 	bool WinSocket::isConnected(void) {	
 		return http_socket != INVALID_SOCKET;
 	}
+	int WinSocket::waitForReadable(const struct timeval &timeout) {
+		fd_set read_fds;
+		FD_ZERO(&read_fds);
+		FD_SET(http_socket, &read_fds);
+		return select(0, &read_fds, NULL, NULL, &timeout);		// SOCKET_ERROR is negative
+	}
+	int WinSocket::waitForReadableOrWake(const struct timeval &timeout, const WakeEvent &wake) {
+		// select() can't wait on an event, so the socket is bound to one for the duration of the wait
+		if (WSAEventSelect(http_socket, socketEvent, FD_READ | FD_CLOSE) == SOCKET_ERROR) {
+			return SOCKET_ERROR;
+		}
+		WSAEVENT events[2] = { socketEvent, wake.handle() };
+		const DWORD timeout_ms = static_cast<DWORD>(timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+		const DWORD result = WSAWaitForMultipleEvents(2, events, FALSE, timeout_ms, FALSE);
+		// WSAEventSelect() leaves the socket non-blocking, recv()/send() expect it blocking
+		WSAEventSelect(http_socket, socketEvent, 0);
+		u_long nonBlocking = 0;
+		ioctlsocket(http_socket, FIONBIO, &nonBlocking);
+		WSAResetEvent(socketEvent);
+		if (result == WSA_WAIT_EVENT_0) {
+			return 1;
+		}
+		return (result == WSA_WAIT_EVENT_0 + 1 || result == WSA_WAIT_TIMEOUT) ? 0 : SOCKET_ERROR;
+	}
+	long WinSocket::receiveSome(char *buffer, const size_t &length) {
+		return recv(http_socket, buffer, static_cast<int>(length), 0);
+	}
 	/* Error Handlers for winsocket API's */
 	void WinSocket::Err_handle_WSAStartup(const int &err_code) {
 		if (err_code != 0) {
@@ -266,62 +354,53 @@ namespace mysocket {
 	void WinSocket::socket_init(void) {
 		Err_handle_WSAStartup((WSAStartup(MAKEWORD(2, 2), &wsaData) != 0));
 		sockaddr_in.sin_family = AF_INET;
+		if (socketEvent == WSA_INVALID_EVENT) {
+			socketEvent = WSACreateEvent();
+		}
 	}
-	void WinSocket::connect(const std::wstring &url, const std::wstring &port) {
+	void WinSocket::connect(const std::string &url, const std::string &port) {
+		if (connectionBehaviour == ConnectionBehaviour::KeepAlive && isPeerConnectionAlive()) {
+			return;				// Reuse the established connection
+		}
+		if (isConnected()) {
+			socket_close();		// Peer dropped the previous connection, reconnect transparently
+		}
 		Err_handle_socket(http_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
-		sockaddr_in.sin_port = htons(std::stoi(ws2s(port)));
-		InetPtonW(AF_INET, url.c_str(), &sockaddr_in.sin_addr);
+		sockaddr_in.sin_port = htons(static_cast<u_short>(std::stoi(port)));
+		inet_pton(AF_INET, url.c_str(), &sockaddr_in.sin_addr);
 		if (::connect(http_socket, (struct sockaddr*)&sockaddr_in, sizeof(sockaddr_in)) == SOCKET_ERROR) {
 			socket_close();
 		}
 	}
-	void WinSocket::transmit(const std::wstring &data, const int& data_size_in_bytes) {
-		if (!isConnected()) {
-			return;
-		}
-		size_t nbytes_total = 0;
-		while (nbytes_total < data.length()) {            // send data to server
-			std::wstring wideChunk = data.substr(nbytes_total);
-			std::string narrowChunk = ws2s(wideChunk);
-			size_t narrowBytesToSend = narrowChunk.length();
-			int nbytes_last = send(http_socket, narrowChunk.c_str(), static_cast<int>(narrowBytesToSend), 0);
-			nbytes_total += nbytes_last; // Increment by the number of bytes sent
-		}		
-	}
-	void WinSocket::receiveResponse(std::wstring &recievedData, const struct timeval &timeout) {
+	bool WinSocket::transmit(std::initializer_list<ConstBuffer> buffers) {
 		if (!isConnected()) {
-			return;
-		}
-		const int readBuff_size{ 1024 };
-		char readBuff[readBuff_size] = {};
-		int bytesRead = 0;
-		fd_set read_fds;
-		FD_ZERO(&read_fds);
-		FD_SET(http_socket, &read_fds);
-
-		std::string tmpDataRead;
-		int select_result = select(0, &read_fds, NULL, NULL, &timeout);
-		
-		if (select_result == SOCKET_ERROR) {
-		//	std::cerr << "select() failed with error: " << WSAGetLastError() << std::endl;
-			socket_close();
+			return false;
 		}
-		else if (select_result == 0) {
-			// Timeout occurred, no data received within timeout_sec seconds
-			socket_close();
-			return;
-		}
-		if (__WSAFDIsSet(http_socket, &read_fds)) {    // Recieve data from server
-			while ((bytesRead = recv(http_socket, readBuff, (readBuff_size - 1), 0)) > 0) {
-				readBuff[bytesRead] = 0x00;
-				tmpDataRead += readBuff;        // Append incomming data to string
+		std::vector<WSABUF> wsaBuffers;
+		wsaBuffers.reserve(buffers.size());
+		for (const auto &buffer : buffers) {
+			if (buffer.length != 0) {
+				wsaBuffers.push_back({ static_cast<ULONG>(buffer.length), const_cast<CHAR*>(buffer.data) });
 			}
 		}
-		if (bytesRead == SOCKET_ERROR) {
-		//	std::cerr << "recv() failed with error: " << WSAGetLastError() << std::endl;
-			socket_close();
+		size_t first = 0;
+		while (first < wsaBuffers.size()) {            // send data to server
+			DWORD nbytes_last = 0;
+			if (WSASend(http_socket, &wsaBuffers[first], static_cast<DWORD>(wsaBuffers.size() - first), &nbytes_last, 0, NULL, NULL) == SOCKET_ERROR) {
+				socket_close();
+				return false;
+			}
+			while (nbytes_last != 0) {				// Skip what was sent, resume from a partially sent buffer
+				const ULONG consumed = (nbytes_last < wsaBuffers[first].len) ? nbytes_last : wsaBuffers[first].len;
+				wsaBuffers[first].buf += consumed;
+				wsaBuffers[first].len -= consumed;
+				nbytes_last -= consumed;
+				if (wsaBuffers[first].len == 0) {
+					++first;
+				}
+			}
 		}
-		recievedData = s2ws(tmpDataRead);
+		return true;
 	}
 	void WinSocket::socket_close() {
 		closesocket(http_socket);
@@ -330,7 +409,13 @@ namespace mysocket {
 	void WinSocket::socket_cleanup() {
 		closesocket(http_socket);
 		http_socket = INVALID_SOCKET;
+		if (socketEvent != WSA_INVALID_EVENT) {
+			WSACloseEvent(socketEvent);
+			socketEvent = WSA_INVALID_EVENT;
+		}
 		WSACleanup();
 	}
 
-}
\ No newline at end of file
+}
+
+#endif
@@ -27,11 +27,21 @@
 #include <fstream>
 #include "json.h"
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#ifdef _WIN32
 #include <lmcons.h>
-#include <codecvt>
+#include <sddl.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 #include <sstream>
 #include "systemInformation.h"
 #include "stringUtil.h"
+#include "base64.h"
 #include <cctype>
 
 
@@ -97,9 +107,14 @@ std::wstring changeDir(const std::wstring& newPath, std::error_code& ec) {
 }
 
 std::wstring getExecutableDir(void) {
+#ifdef _WIN32
     WCHAR buffer[MAX_PATH];
     GetModuleFileNameW(nullptr, buffer, MAX_PATH);
     std::wstring fullPath(buffer);
+#else
+    std::error_code ec;
+    std::wstring fullPath = fs::read_symlink("/proc/self/exe", ec).wstring();
+#endif
     std::wstring directory = fullPath.substr(0, fullPath.find_last_of(L"\\/\\"));
     return directory;
 }
@@ -118,6 +133,18 @@ bool writeFileContents(const std::string& filename, const std::string& fileConte
     }
 }
 
+bool writeFileContentsFromBase64(const fs::path& filePath, const std::string& base64Content) {
+	std::ofstream file(filePath, std::ofstream::out | std::ofstream::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	// Decode straight into the file through a fixed-size buffer, the decoded payload never sits in memory as a whole
+	Base64StreamDecoder decoder([&file](const char *data, const size_t &length) {
+		return static_cast<bool>(file.write(data, static_cast<std::streamsize>(length)));
+	});
+	return decoder.update(base64Content.data(), base64Content.length()) && decoder.finish();
+}
+
 std::wstring extractFilename(const std::wstring& filePath) {
     const size_t lastSlash = filePath.find_last_of(L"/\\"); // Find the last slash or backslash
     if (lastSlash != std::wstring::npos) {
@@ -139,6 +166,7 @@ std::wstring ExtractLastDirectoryName(const std::wstring& path) {
 }
 
 bool isExecutable(const std::wstring& path) {
+#ifdef _WIN32
     struct _stat fileInfo;
     if (_wstat(path.c_str(), &fileInfo) != 0) {
         std::wcerr << L"Error getting file info." << std::endl;
@@ -148,6 +176,16 @@ bool isExecutable(const std::wstring& path) {
     if ((fileInfo.st_mode & _S_IFREG) && (fileInfo.st_mode & _S_IEXEC)) {
         return true;
     }
+#else
+    struct stat fileInfo;
+    if (stat(StringUtils::ws2s(path).c_str(), &fileInfo) != 0) {
+        std::wcerr << L"Error getting file info." << std::endl;
+        return false;
+    }
+    if (S_ISREG(fileInfo.st_mode) && (fileInfo.st_mode & S_IXUSR)) {
+        return true;
+    }
+#endif
     return false;
 }
 
@@ -187,6 +225,120 @@ std::string generateRandomAlphanumeric(const int &length, const long long &seed)
 	return result;
 }
 
+static unsigned long currentProcessId(void) {
+#ifdef _WIN32
+	return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+	return static_cast<unsigned long>(getpid());
+#endif
+}
+
+static bool isProcessAlive(const unsigned long &pid) {
+#ifdef _WIN32
+	HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+	if (hProcess == NULL) {
+		return GetLastError() == ERROR_ACCESS_DENIED;		// Exists, it just isn't ours to query
+	}
+	DWORD exitCode = 0;
+	const bool alive = GetExitCodeProcess(hProcess, &exitCode) && exitCode == STILL_ACTIVE;
+	CloseHandle(hProcess);
+	return alive;
+#else
+	return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+/* Remove the <prefix><pid>-* directories left behind by agents which were killed or crashed, a live agent's are left alone */
+static void removeStalePrivateDirs(const fs::path &tempDir, const std::wstring &prefix) {
+	std::error_code ec;
+	for (fs::directory_iterator entry(tempDir, ec), end; !ec && entry != end; entry.increment(ec)) {
+		const std::wstring name = entry->path().filename().wstring();
+		if (name.compare(0, prefix.length(), prefix) != 0) {
+			continue;
+		}
+		wchar_t *pidEnd = nullptr;
+		const unsigned long pid = std::wcstoul(name.c_str() + prefix.length(), &pidEnd, 10);
+		std::error_code removeError;
+		if (*pidEnd == L'-' && pid != currentProcessId() && !isProcessAlive(pid) && entry->is_directory(removeError)) {
+			fs::remove_all(entry->path(), removeError);
+		}
+	}
+}
+
+/* Create a new directory only this account (and SYSTEM/Administrators) can write to, false if the name is taken */
+static bool createPrivateDirectory(const fs::path &path) {
+#ifdef _WIN32
+	// Protected DACL, nothing inherited from the (possibly world-writable) temp directory
+	SECURITY_ATTRIBUTES securityAttributes{ sizeof(SECURITY_ATTRIBUTES), NULL, FALSE };
+	if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:P(A;OICI;FA;;;OW)(A;OICI;FA;;;SY)(A;OICI;FA;;;BA)",
+		SDDL_REVISION_1, &securityAttributes.lpSecurityDescriptor, NULL)) {
+		return false;
+	}
+	const bool created = CreateDirectoryW(path.wstring().c_str(), &securityAttributes) != 0;
+	LocalFree(securityAttributes.lpSecurityDescriptor);
+	return created;
+#else
+	return mkdir(path.c_str(), S_IRWXU) == 0;
+#endif
+}
+
+fs::path createPrivateTempDirectory(const std::wstring &prefix) {
+	std::error_code ec;
+	const fs::path tempDir = fs::temp_directory_path(ec);
+	if (ec) {
+		return fs::path();
+	}
+	removeStalePrivateDirs(tempDir, prefix);
+	const long long seed = std::chrono::steady_clock::now().time_since_epoch().count();
+	for (int attempt = 0; attempt < 8; ++attempt) {	// A taken name may be a squatter, never reuse a directory we didn't create
+		const fs::path dir = tempDir / (prefix + std::to_wstring(currentProcessId()) + L"-" +
+			StringUtils::s2ws(generateRandomAlphanumeric(8, seed + attempt)));
+		if (createPrivateDirectory(dir)) {
+			return dir;
+		}
+	}
+	return fs::path();
+}
+
+bool writeNewPrivateFile(const fs::path &path, const std::string &content) {
+#ifdef _WIN32
+	// Inherits the owner-only DACL of a directory made by createPrivateTempDirectory()
+	HANDLE hFile = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	bool written = true;
+	for (size_t offset = 0; written && offset < content.length(); ) {
+		const size_t remaining = content.length() - offset;
+		const DWORD chunk = remaining > (1u << 30) ? (1u << 30) : static_cast<DWORD>(remaining);
+		DWORD bytesWritten = 0;
+		written = WriteFile(hFile, content.data() + offset, chunk, &bytesWritten, NULL) != 0;
+		offset += bytesWritten;
+	}
+	CloseHandle(hFile);
+#else
+	const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd == -1) {
+		return false;
+	}
+	bool written = true;
+	for (size_t offset = 0; written && offset < content.length(); ) {
+		const ssize_t bytesWritten = write(fd, content.data() + offset, content.length() - offset);
+		if (bytesWritten == -1 && errno == EINTR) {
+			continue;
+		}
+		written = bytesWritten > 0;
+		offset += written ? static_cast<size_t>(bytesWritten) : 0;
+	}
+	close(fd);
+#endif
+	if (!written) {
+		std::error_code ec;
+		fs::remove(path, ec);
+	}
+	return written;
+}
+
 std::wstring getSysInfoInJson() {
 
 	std::vector<std::wstring> data_vec;
@@ -223,17 +375,6 @@ std::wstring getSysInfoInJson() {
 	return JsonUtil::to_json(data_vec);
 }
 
-std::string extractBase64Data(const std::wstring& buff) {
-    std::size_t found = buff.find(L"\r\n\r\n");
-    if (found != std::wstring::npos) {
-        found += std::wstring(L"\r\n\r\n").length();
-        return StringUtils::ws2s(buff.substr(found));
-    }
-    else {
-        return std::string("");
-    }
-}
-
 std::wstring ReplaceTildeWithPathWindows(const std::wstring& filePath) {
     std::wstring result = filePath;
     size_t tildePos = result.find('~');
@@ -248,13 +389,12 @@ bool IscmdletAvailable(const std::wstring &cmdlet) {
 	const std::wstring command = L"powershell";
 	const std::wstring args = L"Get-Command " + cmdlet;
 
-	HMODULE hExecLib = LoadLibrary(TEXT("executeCommands.dll"));
-	if (hExecLib == NULL) {
+	const auto execLib = ModuleRegistry::acquire(L"executeCommands.dll");
+	if (execLib == nullptr) {
 		std::wcerr <<  L"IscmdletAvailable(): Failed to load executeCommands.dll";
 		return false;
 	}
-	const std::wstring output = executeCommandViaDll(hExecLib, command, args);
-	FreeLibrary(hExecLib);
+	const std::wstring output = executeCommandViaDll(*execLib, command, args);
 
 	std::wstring pattern = L"The term '" + cmdlet + L"' is not recognized";
 	if (output.find(pattern) != std::wstring::npos) {
@@ -292,9 +432,9 @@ std::wstring findCompressionUtility(std::wstring &outputCompressionUtilityPath)
 
 
 
-bool DownloadFileFromURLViaDll(const HMODULE &hFileTransferLib, const std::wstring& url, const std::wstring& destDirPath, std::wstring& errorMsg) {
+bool DownloadFileFromURLViaDll(const LoadedModule &fileTransferLib, const std::wstring& url, const std::wstring& destDirPath, std::wstring& errorMsg) {
 	bool exitStatus;
-	DownloadFileFromURLType DownloadFileFromURL = (DownloadFileFromURLType)(GetProcAddress(hFileTransferLib, "DownloadFileFromURL"));
+	DownloadFileFromURLType DownloadFileFromURL = (DownloadFileFromURLType)(fileTransferLib.function("DownloadFileFromURL"));
 	if (DownloadFileFromURL == nullptr) {
 		return L"Failed to get filemanager() address.";
 	}
@@ -304,9 +444,9 @@ bool DownloadFileFromURLViaDll(const HMODULE &hFileTransferLib, const std::wstri
 	return exitStatus;
 }
 
-bool UploadFileToURLViaDll(const HMODULE &hFileTransferLib, const std::wstring& url, const std::wstring& filePath, std::wstring &errorMsg) {
+bool UploadFileToURLViaDll(const LoadedModule &fileTransferLib, const std::wstring& url, const std::wstring& filePath, std::wstring &errorMsg) {
 	bool exitStatus;
-	UploadFileToURLType UploadFileToURL = (UploadFileToURLType)(GetProcAddress(hFileTransferLib, "UploadFileToURL"));
+	UploadFileToURLType UploadFileToURL = (UploadFileToURLType)(fileTransferLib.function("UploadFileToURL"));
 	if (UploadFileToURL == nullptr) {
 		return L"Failed to get filemanager() address.";
 	}
@@ -316,9 +456,9 @@ bool UploadFileToURLViaDll(const HMODULE &hFileTransferLib, const std::wstring&
 	return exitStatus;
 }
 
-bool UploadDirectoryToURLViaDll(const HMODULE &hFileTransferLib, const std::wstring& url, const std::wstring& dirPath, std::wstring& errorMsg, const std::wstring& extensions) {	
+bool UploadDirectoryToURLViaDll(const LoadedModule &fileTransferLib, const std::wstring& url, const std::wstring& dirPath, std::wstring& errorMsg, const std::wstring& extensions) {	
 	bool exitStatus;
-	UploadDirectoryToURLType UploadDirectoryToURL = (UploadDirectoryToURLType)(GetProcAddress(hFileTransferLib, "UploadDirectoryToURL"));
+	UploadDirectoryToURLType UploadDirectoryToURL = (UploadDirectoryToURLType)(fileTransferLib.function("UploadDirectoryToURL"));
 	if (UploadDirectoryToURL == nullptr) {
 		return L"Failed to get filemanager() address.";
 	}
@@ -328,9 +468,9 @@ bool UploadDirectoryToURLViaDll(const HMODULE &hFileTransferLib, const std::wstr
 	return exitStatus; 
 }
 
-std::wstring filemanagerViaDll(const HMODULE &hFilemanagerLib, const std::wstring &dirToList) {
+std::wstring filemanagerViaDll(const LoadedModule &filemanagerLib, const std::wstring &dirToList) {
 	std::wstring exitStatus;
-	FileMangerType filemanager = (FileMangerType)(GetProcAddress(hFilemanagerLib, "filemanager"));
+	FileMangerType filemanager = (FileMangerType)(filemanagerLib.function("filemanager"));
 	if (filemanager == nullptr) {
 		return L"Failed to get filemanager() address.";
 	}
@@ -340,9 +480,9 @@ std::wstring filemanagerViaDll(const HMODULE &hFilemanagerLib, const std::wstrin
 	return exitStatus;
 }
 
-std::wstring executeCommandViaDll(const HMODULE &hExecLib, const std::wstring& exePath, const std::wstring& arguments) {
+std::wstring executeCommandViaDll(const LoadedModule &execLib, const std::wstring& exePath, const std::wstring& arguments) {
     std::wstring exitStatus;
-	ExecuteCommandType executeCommand = (ExecuteCommandType)(GetProcAddress(hExecLib, "executeCommand"));
+	ExecuteCommandType executeCommand = (ExecuteCommandType)(execLib.function("executeCommand"));
     if (executeCommand == nullptr) {
         return L"Failed to get executeCommand() address.";
     }
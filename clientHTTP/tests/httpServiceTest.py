@@ -0,0 +1,167 @@
+# Copyright (c) Nouman Tajik [github.com/tajiknomi]
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# httpService_t against a loopback mock server, on the POSIX/epoll transport:
+#   python httpServiceTest.py <path to the clienthttp executable>
+# The server answers a few long-poll heartbeats on one keep-alive connection, then hands out two jobs:
+#   deleteFile  quick, its result may come back on either connection
+#   copy        of a large file, so it finishes while the next long-poll is held: its result has to come back on the
+#               client's second connection, and the held connection has to stay usable afterwards
+
+import base64
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import http.server
+import socketserver
+
+ROUND_TRIPS = 3                 # Plain long-poll heartbeats answered before the first job is handed out
+ROUND_TRIP_HOLD_SEC = 0.2       # How long the server sits on each of them
+HELD_POLL_SEC = 15              # Upper bound on holding a long-poll while a job runs, released early by its result
+IDLE_POLL_SEC = 1.0             # The long-poll after the last result, answered with nothing to do
+COPY_SIZE = 256 * 1024 * 1024   # Big enough that the copy outlasts sending the next heartbeat
+
+
+class MockServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+    def __init__(self, jobs):
+        self.jobs = jobs                        # Handed out one at a time, the next once the previous result is in
+        self.lock = threading.Lock()
+        self.requests = []                      # (client port, Prefer header, decoded body, held poll ports at arrival)
+        self.heartbeats = 0
+        self.jobRunning = False
+        self.resultArrived = threading.Condition(self.lock)
+        self.heldPorts = set()
+        self.idlePolls = 0
+        self.finished = threading.Event()
+        super().__init__(("127.0.0.1", 0), Handler)
+
+    def handle_error(self, request, client_address):
+        if not isinstance(sys.exc_info()[1], (BrokenPipeError, ConnectionResetError)):     # The client is killed at the end
+            super().handle_error(request, client_address)
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        server = self.server
+        body = json.loads(base64.b64decode(self.rfile.read(int(self.headers["Content-Length"]))))
+        prefer = self.headers.get("Prefer")
+        port = self.client_address[1]
+        reply = {"mode": "standard"}
+        with server.lock:
+            server.requests.append((port, prefer, body, set(server.heldPorts)))
+            if "log" in body:
+                server.jobRunning = False
+                server.resultArrived.notify_all()
+            elif server.jobRunning:
+                server.heldPorts.add(port)      # A long-poll with nothing to hand out until the job is done
+                server.resultArrived.wait_for(lambda: not server.jobRunning, HELD_POLL_SEC)
+                server.heldPorts.discard(port)
+            else:
+                server.heartbeats += 1
+                if server.heartbeats > ROUND_TRIPS and server.jobs:
+                    reply = server.jobs.pop(0)
+                    server.jobRunning = True
+                elif server.heartbeats > ROUND_TRIPS:
+                    server.idlePolls += 1
+                    if server.idlePolls == 2:
+                        server.finished.set()
+        if reply["mode"] == "standard" and "log" not in body and server.heartbeats <= ROUND_TRIPS:
+            time.sleep(ROUND_TRIP_HOLD_SEC)
+        elif reply["mode"] == "standard" and "log" not in body and server.idlePolls == 1:
+            time.sleep(IDLE_POLL_SEC)
+        out = base64.b64encode(json.dumps(reply).encode())
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(out)))
+        if prefer:
+            self.send_header("Preference-Applied", prefer)
+        self.end_headers()
+        self.wfile.write(out)
+
+    def log_message(self, *args):
+        pass
+
+
+def check(condition, message):
+    if not condition:
+        raise AssertionError(message)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: " + sys.argv[0] + " <clienthttp executable>")
+        return 2
+    workDir = tempfile.mkdtemp(prefix="httpServiceTest-")
+    victimPath = os.path.join(workDir, "victim.txt")
+    sourcePath = os.path.join(workDir, "large.bin")
+    destDir = os.path.join(workDir, "copies")
+    open(victimPath, "w").close()
+    os.makedirs(destDir)
+    with open(sourcePath, "wb") as source:
+        block = b"\x5a" * (1024 * 1024)
+        for _ in range(COPY_SIZE // len(block)):
+            source.write(block)
+    server = MockServer([{"mode": "deleteFile", "filePath": victimPath},
+                         {"mode": "copy", "sourcePath": sourcePath, "destPath": destDir}])
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    client = subprocess.Popen([sys.argv[1], "127.0.0.1", str(server.server_address[1])], cwd=workDir,
+                              stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        check(server.finished.wait(30), "the client didn't get through both jobs")
+        with server.lock:
+            requests = list(server.requests)
+        heartbeats = [request for request in requests if "log" not in request[2]]
+        results = [request for request in requests if "log" in request[2]]
+        pollPort = heartbeats[0][0]
+
+        check(all(request[1] == "wait=25" for request in heartbeats), "a heartbeat without Prefer: wait")
+        check(all(request[0] == pollPort for request in heartbeats), "the heartbeats didn't keep one connection alive")
+        check(heartbeats[0][2].get("id"), "the heartbeat carries no client id")
+        check(all(request[2].get("id") == heartbeats[0][2]["id"] for request in requests), "a request with another client id")
+
+        check(len(results) == 2, "expected two job results, got " + str(len(results)))
+        check("deleted successfully" in results[0][2]["log"], "unexpected deleteFile result: " + results[0][2]["log"])
+        check(not os.path.exists(victimPath), "the deleteFile job didn't run")
+        check("copied" in results[1][2]["log"], "unexpected copy result: " + results[1][2]["log"])
+        check(os.path.getsize(os.path.join(destDir, "large.bin")) == COPY_SIZE, "the copy job didn't run")
+        check(pollPort in results[1][3], "the copy finished before the long-poll was held")
+        check(results[1][0] != pollPort, "the copy result waited for the held long-poll")
+        print("PASS httpServiceLoopback:", len(heartbeats), "heartbeats,", len({request[0] for request in requests}), "connections", flush=True)
+        return 0
+    except AssertionError as error:
+        print("FAIL httpServiceLoopback:", error, flush=True)
+        return 1
+    finally:
+        client.kill()
+        client.wait()
+        server.shutdown()
+        shutil.rmtree(workDir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
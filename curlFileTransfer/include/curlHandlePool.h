@@ -0,0 +1,95 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include "curl/curl.h"
+
+/*
+	Easy handles outlive the transfer they were used for. A handle keeps its connections
+	across curl_easy_reset(), so consecutive uploads to the data server ride warm keep-alive
+	connections, within a job and across jobs. All handles share one DNS and TLS session cache.
+	A multi handle owns the connections of the transfers run on it, so the multi handle is
+	pooled as well: its connection cache carries warm connections from one directory upload
+	to the next. Only one directory upload at a time gets the kept one, a concurrent one runs
+	on a multi handle of its own.
+	Lives until shutdown(), which the host calls (ShutdownModule) before unloading the module.
+*/
+class CurlHandlePool {
+
+private:
+	static constexpr size_t maxIdleHandles{ 8 };
+	static constexpr size_t maxIdleMultiHandles{ 1 };
+	static CurlHandlePool* pool;
+	static std::once_flag poolOnce;
+	std::mutex idleMutex;
+	std::vector<CURL*> idle;
+	std::vector<CURLM*> idleMulti;
+	CURLSH* share;
+	std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+
+private:
+	CurlHandlePool();
+	static void lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+	static void unlockShare(CURL* handle, curl_lock_data data, void* userptr);
+
+public:
+	CurlHandlePool(const CurlHandlePool&) = delete;
+	CurlHandlePool& operator=(const CurlHandlePool&) = delete;
+	~CurlHandlePool();
+
+	static CurlHandlePool& instance(void);
+	static void shutdown(void);				/* No transfer may be running or start afterwards, a no-op if the pool was never used */
+	CURL* acquire(void);					/* Options reset to defaults, nullptr if libcurl fails */
+	void reset(CURL* curl);					/* Options back to defaults between requests on one handle, connections are kept */
+	void release(CURL* curl);				/* Back to the pool, or cleaned up if the pool is full */
+	CURLM* acquireMulti(void);				/* With the connections of earlier transfers on it, nullptr if libcurl fails */
+	void releaseMulti(CURLM* multi);		/* No easy handles may be attached, cleaned up if the pool is full */
+};
+
+/* Returns its handle to the pool on every exit path */
+class PooledCurlHandle {
+
+private:
+	CURL* curl;
+
+public:
+	PooledCurlHandle() : curl(CurlHandlePool::instance().acquire()) {}
+	PooledCurlHandle(const PooledCurlHandle&) = delete;
+	PooledCurlHandle& operator=(const PooledCurlHandle&) = delete;
+	~PooledCurlHandle() { if (curl != nullptr) CurlHandlePool::instance().release(curl); }
+	CURL* get(void) const { return curl; }
+};
+
+/* Returns its multi handle to the pool on every exit path */
+class PooledMultiHandle {
+
+private:
+	CURLM* multi;
+
+public:
+	PooledMultiHandle() : multi(CurlHandlePool::instance().acquireMulti()) {}
+	PooledMultiHandle(const PooledMultiHandle&) = delete;
+	PooledMultiHandle& operator=(const PooledMultiHandle&) = delete;
+	~PooledMultiHandle() { if (multi != nullptr) CurlHandlePool::instance().releaseMulti(multi); }
+	CURLM* get(void) const { return multi; }
+};
@@ -25,20 +25,41 @@
 #include "curl/curl.h"
 #include "stringUtil.h"
 #include <filesystem>
+#include <chrono>
 
 namespace fs = std::filesystem;
 
 class curlFileTransfer {
 
+private:
+	struct UploadTransfer;
+	struct DownloadTransfer;
+	static constexpr size_t maxConcurrentUploads{ 8 };		/* Directory upload, files in flight at once */
+	static constexpr size_t maxReportedFailures{ 20 };		/* Directory upload, failed files listed in errorMsg */
+	static constexpr size_t uploadQueueCapacity{ 1024 };		/* Directory upload, files the walk may find ahead of the uploads */
+	static constexpr curl_off_t chunkedUploadThreshold{ 64LL * 1024 * 1024 };	/* Files from this size up go in resumable chunks, if the server supports it */
+	static constexpr size_t uploadChunkSize{ 8 * 1024 * 1024 };
+	static constexpr int maxChunkRetries{ 5 };				/* Consecutive chunk failures before giving up, a later job resumes from the journal */
+	static constexpr std::chrono::hours uploadJournalMaxAge{ 7 * 24 };	/* A given-up upload not resumed within this is forgotten */
+
 private:
 	static std::wstring extractFilename(const std::wstring& filePath);
 	static size_t WriteData(void* buffer, size_t size, size_t nmemb, void* userp);
 	static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
 	static size_t readCallback(char* buffer, size_t size, size_t nitems, void* stream);
+	static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userp);
 	static bool isDataServerAvailable(const std::string& url);
+	static bool startDownload(DownloadTransfer& transfer);
+	static bool prepareUpload(UploadTransfer& transfer, const std::string& url_utf8, std::wstring& errorMsg);
+	static bool uploadWholeFile(const std::string& url_utf8, const std::wstring& filePath, std::wstring& errorMsg);		/* Single multipart POST */
+	static int queryUploadOffset(CURL* curl, const std::string& url_utf8, const std::string& uploadId, curl_off_t& offset);	/* 1 = offset known, 0 = server has no chunked uploads, -1 = failed, worth a retry */
+	static bool uploadFileInChunks(const std::string& url_utf8, const std::wstring& filePath, const curl_off_t& fileSize, bool& serverSupportsChunks, std::wstring& errorMsg);
+	static bool uploadLargeFile(const std::string& url_utf8, const std::wstring& filePath, const curl_off_t& fileSize, std::wstring& errorMsg);	/* Chunked, or whole if the server can't */
 
 public:		/* Public API */
 	static bool DownloadFileFromURL(const std::wstring& url, const std::wstring& destDirPath, std::wstring& errorMsg);
 	static bool UploadFileToURL(const std::wstring& url, const std::wstring& filePath, std::wstring& errorMsg);
 	static bool UploadDirectoryToURL(const std::wstring& url, const std::wstring& dirPath, std::wstring& errorMsg, const std::wstring& extensions = L"");
+
+	static void ShutdownModule(void);		/* Releases the pooled curl handles and libcurl, the host calls it just before unloading the module */
 };
\ No newline at end of file
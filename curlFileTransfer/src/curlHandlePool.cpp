@@ -0,0 +1,130 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "curlHandlePool.h"
+
+CurlHandlePool* CurlHandlePool::pool{ nullptr };
+std::once_flag CurlHandlePool::poolOnce;
+
+CurlHandlePool::CurlHandlePool() : share(nullptr) {
+	curl_global_init(CURL_GLOBAL_DEFAULT);		// Not thread-safe, instance() makes sure it runs once
+	share = curl_share_init();
+	if (share != nullptr) {
+		curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+		curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+		curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+		// Not CURL_LOCK_DATA_CONNECT: libcurl doesn't support a shared connection cache between concurrent threads,
+		// each handle keeps its own connections instead
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	}
+}
+
+CurlHandlePool::~CurlHandlePool() {
+	for (CURLM* multi : idleMulti) {
+		curl_multi_cleanup(multi);				// Closes the connections it kept
+	}
+	for (CURL* curl : idle) {
+		curl_easy_cleanup(curl);
+	}
+	if (share != nullptr) {
+		curl_share_cleanup(share);
+	}
+	curl_global_cleanup();
+}
+
+void CurlHandlePool::lockShare(CURL* /*handle*/, curl_lock_data data, curl_lock_access /*access*/, void* userptr) {
+	static_cast<CurlHandlePool*>(userptr)->shareLocks[data].lock();
+}
+
+void CurlHandlePool::unlockShare(CURL* /*handle*/, curl_lock_data data, void* userptr) {
+	static_cast<CurlHandlePool*>(userptr)->shareLocks[data].unlock();
+}
+
+CurlHandlePool& CurlHandlePool::instance(void) {
+	// Heap allocated, a static object would be destroyed from DllMain under the loader lock, where curl cleanup can deadlock
+	std::call_once(poolOnce, [] { pool = new CurlHandlePool; });
+	return *pool;
+}
+
+void CurlHandlePool::shutdown(void) {
+	delete pool;
+	pool = nullptr;
+}
+
+CURL* CurlHandlePool::acquire(void) {
+	CURL* curl = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		if (!idle.empty()) {
+			curl = idle.back();
+			idle.pop_back();
+		}
+	}
+	if (curl != nullptr) {
+		reset(curl);
+	}
+	else if ((curl = curl_easy_init()) != nullptr) {
+		reset(curl);
+	}
+	return curl;
+}
+
+void CurlHandlePool::reset(CURL* curl) {
+	curl_easy_reset(curl);						// Keeps its live connections
+	if (share != nullptr) {
+		curl_easy_setopt(curl, CURLOPT_SHARE, share);
+	}
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);		// Keep idle pooled connections from being dropped by middleboxes
+}
+
+void CurlHandlePool::release(CURL* curl) {
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		if (idle.size() < maxIdleHandles) {
+			idle.push_back(curl);
+			return;
+		}
+	}
+	curl_easy_cleanup(curl);
+}
+
+CURLM* CurlHandlePool::acquireMulti(void) {
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		if (!idleMulti.empty()) {
+			CURLM* multi = idleMulti.back();
+			idleMulti.pop_back();
+			return multi;
+		}
+	}
+	return curl_multi_init();
+}
+
+void CurlHandlePool::releaseMulti(CURLM* multi) {
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		if (idleMulti.size() < maxIdleMultiHandles) {
+			idleMulti.push_back(multi);
+			return;
+		}
+	}
+	curl_multi_cleanup(multi);
+}
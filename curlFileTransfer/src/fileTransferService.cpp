@@ -19,7 +19,388 @@
 // SOFTWARE. 
 
 #include "fileTransferService.h"
+#include "curlHandlePool.h"
 #include <fstream>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cctype>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#include <sddl.h>
+#include <aclapi.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+/*
+	Resumable chunked uploads. The protocol, for the data server to implement:
+	  HEAD  <url>   Upload-Id: <id>
+	        -> 2xx with "Upload-Offset: <bytes received so far>" (0 for an unknown id).
+	           A 404, 405 or 501 reply, or a 2xx without Upload-Offset, means the server has no chunked uploads, the file
+	           then goes as one multipart POST. Any other failure is retried.
+	  PATCH <url>   Upload-Id, Upload-Offset, Upload-Length (whole file), Upload-Name (percent-encoded UTF-8 path),
+	                Upload-Checksum: crc32 <8 hex digits>, body = the chunk
+	        -> 2xx with the new Upload-Offset once the chunk is verified and stored. Anything else, and the client asks for
+	           the offset again before it retries.
+	The upload is complete when Upload-Offset reaches Upload-Length. The id is random per upload and kept with the
+	confirmed offset in a journal, in a temp subdirectory only this account can use, so a later job resumes the same upload
+	if the file is unchanged.
+	A journal is dropped once the file's size or last write time no longer match it, or once it is uploadJournalMaxAge old.
+*/
+namespace {
+
+	uint32_t crc32(const char* data, const size_t& length) {
+		static const struct Table {
+			uint32_t entries[256];
+			Table() {
+				for (uint32_t i = 0; i < 256; ++i) {
+					uint32_t crc = i;
+					for (int bit = 0; bit < 8; ++bit) {
+						crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+					}
+					entries[i] = crc;
+				}
+			}
+		} table;
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < length; ++i) {
+			crc = table.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+		}
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	std::string toHex(uint64_t value, const int& digits) {
+		static const char hexDigits[] = "0123456789abcdef";
+		std::string hex(digits, '0');
+		for (int i = digits - 1; i >= 0; --i, value >>= 4) {
+			hex[i] = hexDigits[value & 0xF];
+		}
+		return hex;
+	}
+
+	/* Value of a response header out of the raw header block, name is lower case */
+	bool findHeaderValue(const std::string& headers, const std::string& lowerCaseName, std::string& value) {
+		size_t lineStart = 0;
+		while (lineStart < headers.length()) {
+			size_t lineEnd = headers.find('\n', lineStart);
+			if (lineEnd == std::string::npos) {
+				lineEnd = headers.length();
+			}
+			const size_t colon = headers.find(':', lineStart);
+			if (colon < lineEnd && colon - lineStart == lowerCaseName.length()) {
+				bool matches = true;
+				for (size_t i = 0; i < lowerCaseName.length() && matches; ++i) {
+					matches = std::tolower(static_cast<unsigned char>(headers[lineStart + i])) == lowerCaseName[i];
+				}
+				if (matches) {
+					const size_t first = headers.find_first_not_of(" \t", colon + 1);
+					const size_t last = headers.find_last_not_of(" \t\r", lineEnd - 1);
+					value = (first != std::string::npos && first <= last) ? headers.substr(first, last - first + 1) : std::string();
+					return true;
+				}
+			}
+			lineStart = lineEnd + 1;
+		}
+		return false;
+	}
+
+	/* First byte position of a "bytes <first>-<last>/<length>" Content-Range */
+	bool parseContentRangeStart(const std::string& contentRange, curl_off_t& start) {
+		static const std::string unit = "bytes ";
+		if (contentRange.compare(0, unit.length(), unit) != 0) {
+			return false;
+		}
+		const size_t dash = contentRange.find('-', unit.length());
+		if (dash == std::string::npos || dash == unit.length() ||
+			contentRange.find_first_not_of("0123456789", unit.length()) != dash) {
+			return false;
+		}
+		try {
+			start = static_cast<curl_off_t>(std::stoll(contentRange.substr(unit.length(), dash - unit.length())));
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		return true;
+	}
+
+	/* Owner-only permissions, fails rather than open a file that already exists */
+	bool writeNewPrivateFile(const fs::path& path, const std::string& content) {
+#ifdef _WIN32
+		// Inherits the owner-only DACL of journalDirectory()
+		HANDLE hFile = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		DWORD bytesWritten = 0;
+		bool written = WriteFile(hFile, content.data(), static_cast<DWORD>(content.length()), &bytesWritten, NULL) != 0 &&
+			bytesWritten == content.length();
+		CloseHandle(hFile);
+#else
+		const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+		if (fd == -1) {
+			return false;
+		}
+		bool written = true;
+		for (size_t offset = 0; written && offset < content.length(); ) {
+			const ssize_t bytesWritten = write(fd, content.data() + offset, content.length() - offset);
+			if (bytesWritten == -1 && errno == EINTR) {
+				continue;
+			}
+			written = bytesWritten > 0;
+			offset += written ? static_cast<size_t>(bytesWritten) : 0;
+		}
+		close(fd);
+#endif
+		if (!written) {
+			std::error_code ec;
+			fs::remove(path, ec);
+		}
+		return written;
+	}
+
+#ifdef _WIN32
+	/* SID of the account this process runs as, as a string. Empty on failure */
+	std::wstring currentUserSid(void) {
+		HANDLE hToken = NULL;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken)) {
+			return std::wstring();
+		}
+		DWORD length = 0;
+		GetTokenInformation(hToken, TokenUser, NULL, 0, &length);
+		std::vector<BYTE> tokenUser(length);
+		std::wstring sid;
+		LPWSTR sidString = NULL;
+		if (length > 0 && GetTokenInformation(hToken, TokenUser, tokenUser.data(), length, &length) &&
+			ConvertSidToStringSidW(reinterpret_cast<TOKEN_USER*>(tokenUser.data())->User.Sid, &sidString)) {
+			sid = sidString;
+			LocalFree(sidString);
+		}
+		CloseHandle(hToken);
+		return sid;
+	}
+#endif
+
+	/*
+		<temp dir>/clienthttp-upload-journals-<account>. The name is stable so a later job finds the journals, which is
+		also why it can't simply be a new random directory: an existing one is used only if this account owns it, and
+		on Windows its DACL is reset to owner-only. Empty if it can't be trusted, uploads then just aren't resumable.
+	*/
+	fs::path journalDirectory(void) {
+		static const fs::path directory = []() {
+			std::error_code ec;
+			const fs::path tempDir = fs::temp_directory_path(ec);
+			if (ec) {
+				return fs::path();
+			}
+#ifdef _WIN32
+			const std::wstring sid = currentUserSid();
+			if (sid.empty()) {
+				return fs::path();
+			}
+			const fs::path dir = tempDir / (L"clienthttp-upload-journals-" + sid);
+			PSECURITY_DESCRIPTOR ownerOnly = NULL;
+			if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:P(A;OICI;FA;;;OW)(A;OICI;FA;;;SY)(A;OICI;FA;;;BA)",
+				SDDL_REVISION_1, &ownerOnly, NULL)) {
+				return fs::path();
+			}
+			SECURITY_ATTRIBUTES securityAttributes{ sizeof(SECURITY_ATTRIBUTES), ownerOnly, FALSE };
+			bool trusted = CreateDirectoryW(dir.wstring().c_str(), &securityAttributes) != 0;
+			if (!trusted && GetLastError() == ERROR_ALREADY_EXISTS) {
+				const DWORD attributes = GetFileAttributesW(dir.wstring().c_str());
+				PSID owner = NULL;
+				PSECURITY_DESCRIPTOR current = NULL;
+				PSID expectedOwner = NULL;
+				if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) && !(attributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+					GetNamedSecurityInfoW(dir.wstring().c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION, &owner, NULL, NULL, NULL, &current) == ERROR_SUCCESS &&
+					ConvertStringSidToSidW(sid.c_str(), &expectedOwner) && EqualSid(owner, expectedOwner)) {
+					BOOL daclPresent = FALSE, daclDefaulted = FALSE;
+					PACL dacl = NULL;
+					trusted = GetSecurityDescriptorDacl(ownerOnly, &daclPresent, &dacl, &daclDefaulted) &&
+						SetNamedSecurityInfoW(const_cast<LPWSTR>(dir.wstring().c_str()), SE_FILE_OBJECT,
+							DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION, NULL, NULL, dacl, NULL) == ERROR_SUCCESS;
+				}
+				LocalFree(expectedOwner);
+				LocalFree(current);
+			}
+			LocalFree(ownerOnly);
+			return trusted ? dir : fs::path();
+#else
+			const fs::path dir = tempDir / ("clienthttp-upload-journals-" + std::to_string(geteuid()));
+			if (mkdir(dir.c_str(), S_IRWXU) == 0) {
+				return dir;
+			}
+			struct stat status;
+			if (errno == EEXIST && lstat(dir.c_str(), &status) == 0 && S_ISDIR(status.st_mode) &&
+				status.st_uid == geteuid() && (status.st_mode & (S_IRWXG | S_IRWXO)) == 0) {
+				return dir;
+			}
+			return fs::path();
+#endif
+		}();
+		return directory;
+	}
+
+	/* Checkpoint of one chunked upload: which upload id the file went out under and the last offset the server confirmed */
+	struct UploadJournal {
+		fs::path path;									/* Empty without a trusted journalDirectory() */
+		std::string uploadId;
+		curl_off_t fileSize = 0;
+		long long modified = 0;
+		curl_off_t offset = 0;
+
+		explicit UploadJournal(const std::string& filePath_utf8) {
+			uint64_t hash = 14695981039346656037ull;			// FNV-1a of the path names the journal
+			for (const char c : filePath_utf8) {
+				hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+			}
+			const fs::path directory = journalDirectory();
+			if (!directory.empty()) {
+				path = directory / (toHex(hash, 16) + ".journal");
+			}
+		}
+		bool load(void) {
+			if (path.empty()) {
+				return false;
+			}
+			std::ifstream file(path);
+			return static_cast<bool>(file >> uploadId >> fileSize >> modified >> offset);
+		}
+		void save(void) const {
+			if (path.empty()) {
+				return;
+			}
+			const fs::path tmpPath = path.string() + ".tmp";
+			std::error_code ec;
+			fs::remove(tmpPath, ec);						// Left by a save that was interrupted
+			const std::string content = uploadId + '\n' + std::to_string(fileSize) + '\n' + std::to_string(modified) + '\n' + std::to_string(offset) + '\n';
+			if (!writeNewPrivateFile(tmpPath, content)) {
+				return;										// A lost checkpoint only costs a restart from the server's offset
+			}
+			fs::rename(tmpPath, path, ec);					// Replaces the previous checkpoint in one step
+		}
+		void remove(void) const {
+			if (!path.empty()) {
+				std::error_code ec;
+				fs::remove(path, ec);
+			}
+		}
+	};
+
+	/* Journals of uploads which were given up and never retried, their names only carry a hash of the path */
+	void removeExpiredJournals(const std::chrono::hours& maxAge) {
+		const fs::path directory = journalDirectory();
+		if (directory.empty()) {
+			return;
+		}
+		std::error_code ec;
+		const fs::file_time_type now = fs::file_time_type::clock::now();
+		for (fs::directory_iterator entry(directory, ec), end; !ec && entry != end; entry.increment(ec)) {
+			std::error_code timeError;
+			const fs::file_time_type written = entry->last_write_time(timeError);
+			if (!timeError && now - written > maxAge) {
+				fs::remove(entry->path(), timeError);
+			}
+		}
+	}
+
+	std::string newUploadId(void) {
+		std::random_device device;
+		std::mt19937_64 generator((static_cast<uint64_t>(device()) << 32) ^ device() ^
+			static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+		return toHex(generator(), 16) + toHex(generator(), 16);
+	}
+}
+
+/* Bounded hand-off from the directory walk to the uploads, the walk blocks while it is full */
+class UploadWorkQueue {
+
+private:
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	std::deque<std::wstring> paths;
+	const size_t capacity;
+	bool closed;							/* Walk finished */
+	std::atomic<bool> cancelled;			/* Uploads gave up, the walk should stop */
+
+public:
+	enum class PopResult { Item, Empty, Finished };
+
+	explicit UploadWorkQueue(const size_t& capacity) : capacity(capacity), closed(false), cancelled(false) {}
+
+	bool push(std::wstring&& path) {		/* false once cancelled */
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this] { return paths.size() < capacity || cancelled; });
+		if (cancelled) {
+			return false;
+		}
+		paths.push_back(std::move(path));
+		notEmpty.notify_one();
+		return true;
+	}
+	void close(void) {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notEmpty.notify_all();
+	}
+	void cancel(void) {
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelled = true;
+		notFull.notify_all();
+	}
+	bool isCancelled(void) const {			/* Lock-free, polled by the walk between entries */
+		return cancelled.load(std::memory_order_relaxed);
+	}
+	PopResult tryPop(std::wstring& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return take(path);
+	}
+	PopResult waitPop(std::wstring& path) {	/* Item or Finished, never Empty */
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this] { return !paths.empty() || closed; });
+		return take(path);
+	}
+
+private:
+	PopResult take(std::wstring& path) {	/* mutex held */
+		if (paths.empty()) {
+			return closed ? PopResult::Finished : PopResult::Empty;
+		}
+		path = std::move(paths.front());
+		paths.pop_front();
+		notFull.notify_one();
+		return PopResult::Item;
+	}
+};
+
+/* One file upload on a pooled handle, the file stays open and the form alive until the transfer completes */
+struct curlFileTransfer::UploadTransfer {
+	PooledCurlHandle handle;
+	std::wstring filePath;
+	std::ifstream fileStream;
+	curl_mime* mime = nullptr;
+
+	~UploadTransfer() {
+		if (mime != nullptr) {
+			curl_easy_setopt(handle.get(), CURLOPT_MIMEPOST, NULL);		// The handle goes on to the next upload, mime doesn't
+			curl_mime_free(mime);
+		}
+	}
+};
 
 std::wstring curlFileTransfer::extractFilename(const std::wstring& filePath) {
 	const size_t lastSlash = filePath.find_last_of(L"/\\"); // Find the last slash or backslash
@@ -29,9 +410,33 @@ std::wstring curlFileTransfer::extractFilename(const std::wstring& filePath) {
 	return filePath; // If no slashes or backslashes found, return the original path as the filename
 }
 
+/*
+	A download goes to "<file>.part" and is renamed over <file> once complete. The response's validator (a strong ETag,
+	otherwise Last-Modified) is kept in "<file>.part.validator", so a failed download is resumed with a Range request
+	guarded by If-Range: the server sends only the missing tail (206), or the whole file (200) if it has changed since.
+*/
+struct curlFileTransfer::DownloadTransfer {
+	CURL* curl = nullptr;
+	fs::path partPath;
+	fs::path validatorPath;
+	curl_off_t resumeFrom = 0;
+	std::string responseHeaders;
+	std::ofstream file;
+	bool started = false;
+	bool rangeMismatch = false;			/* 206 for other bytes than the part ends with */
+};
+
 size_t curlFileTransfer::WriteData(void* buffer, size_t size, size_t nmemb, void* userp) {
-	std::ofstream* file = static_cast<std::ofstream*>(userp);
-	file->write(static_cast<const char*>(buffer), size * nmemb);
+	DownloadTransfer* transfer = static_cast<DownloadTransfer*>(userp);
+	if (!transfer->started && !startDownload(*transfer)) {
+		return 0;														// Aborts the transfer with CURLE_WRITE_ERROR
+	}
+	if (transfer->file.is_open()) {									// Error pages are drained, not written
+		transfer->file.write(static_cast<const char*>(buffer), size * nmemb);
+		if (!transfer->file) {
+			return 0;
+		}
+	}
 	return size * nmemb;
 }
 
@@ -45,6 +450,15 @@ size_t curlFileTransfer::readCallback(char* buffer, size_t size, size_t nitems,
 	return fileStream->gcount();  // Return the actual number of bytes read
 }
 
+size_t curlFileTransfer::HeaderCallback(char* buffer, size_t size, size_t nitems, void* userp) {
+	std::string* headers = static_cast<std::string*>(userp);
+	if (size * nitems >= 5 && std::string(buffer, 5) == "HTTP/") {
+		headers->clear();												// Only the final response counts, not the redirects or a 100 Continue before it
+	}
+	headers->append(buffer, size * nitems);
+	return size * nitems;
+}
+
 bool curlFileTransfer::isDataServerAvailable(const std::string& url) {
 
 	CURL* curl = curl_easy_init();
@@ -71,68 +485,169 @@ bool curlFileTransfer::isDataServerAvailable(const std::string& url) {
 	return false;  // Port is either closed or didn't respond as expected.
 }
 
+bool curlFileTransfer::startDownload(DownloadTransfer &transfer) {
+
+	transfer.started = true;
+	long responseCode = 0;
+	curl_easy_getinfo(transfer.curl, CURLINFO_RESPONSE_CODE, &responseCode);
+	if (responseCode != 200 && responseCode != 206) {
+		return true;
+	}
+	if (responseCode == 200) {
+		transfer.resumeFrom = 0;									// Changed file or no range support, the old part is of no use
+	}
+	else {
+		std::string contentRange;
+		curl_off_t start = -1;
+		if (!findHeaderValue(transfer.responseHeaders, "content-range", contentRange) ||
+			!parseContentRangeStart(contentRange, start) || start != transfer.resumeFrom) {
+			transfer.rangeMismatch = true;							// Appending would corrupt the part, start over
+			return false;
+		}
+	}
+	transfer.file.open(transfer.partPath, transfer.resumeFrom > 0 ? std::ios::binary | std::ios::app : std::ios::binary | std::ios::trunc);
+	if (!transfer.file) {
+		return false;
+	}
+	std::string validator;
+	if (!(findHeaderValue(transfer.responseHeaders, "etag", validator) && validator.compare(0, 2, "W/") != 0) &&
+		!findHeaderValue(transfer.responseHeaders, "last-modified", validator)) {
+		validator.clear();											// Weak ETags can't be used with If-Range
+	}
+	std::error_code ec;
+	if (validator.empty()) {
+		fs::remove(transfer.validatorPath, ec);					// Without a validator a later resume can't be trusted
+	}
+	else if (responseCode == 200) {
+		std::ofstream(transfer.validatorPath, std::ios::trunc) << validator;
+	}
+	return true;
+}
+
 bool curlFileTransfer::DownloadFileFromURL(const std::wstring &url, const std::wstring &destDirPath, std::wstring &errorMsg) {
 
-	CURL* curl = curl_easy_init();
+	PooledCurlHandle handle;
+	CURL* curl = handle.get();
 	if (!curl) {
 		errorMsg = L"Failed to initialize libcurl";
 		return false;
 	}
 
-	std::wstring outputFilePath = destDirPath + L"/" + url.substr(url.find_last_of('/') + 1);
-	std::ofstream outputFile(outputFilePath, std::ios::binary);
-	if (!outputFile) {
-		errorMsg = L"Failed to open output file: " + outputFilePath;
-		curl_easy_cleanup(curl);
+	const std::wstring fileName = url.substr(url.find_last_of('/') + 1);
+	if (fileName.empty()) {
+		errorMsg = L"No file name in the URL: " + url;
 		return false;
 	}
+	const std::wstring outputFilePath = destDirPath + L"/" + fileName;
+	const fs::path outputPath(outputFilePath);
+	std::error_code ec;
 
-	curl_easy_setopt(curl, CURLOPT_URL, StringUtils::ws2s(url).c_str());
-	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteData);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &outputFile);
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		DownloadTransfer transfer;
+		transfer.curl = curl;
+		transfer.partPath = fs::path(outputFilePath + L".part");
+		transfer.validatorPath = fs::path(outputFilePath + L".part.validator");
 
-	CURLcode res = curl_easy_perform(curl);
-	if (res != 0) {
-		errorMsg = L"Failed to download file. curlError: " + StringUtils::s2ws(curl_easy_strerror(res));
-		curl_easy_cleanup(curl);
-		outputFile.close();
-		return false;
+		std::string validator;
+		const uintmax_t partSize = fs::file_size(transfer.partPath, ec);
+		if (!ec && partSize > 0) {
+			std::ifstream validatorFile(transfer.validatorPath);
+			std::getline(validatorFile, validator);
+		}
+		transfer.resumeFrom = (attempt == 0 && !validator.empty()) ? static_cast<curl_off_t>(partSize) : 0;
+
+		CurlHandlePool::instance().reset(curl);
+		struct curl_slist* headers = NULL;
+		if (transfer.resumeFrom > 0) {
+			headers = curl_slist_append(headers, ("If-Range: " + validator).c_str());
+			curl_easy_setopt(curl, CURLOPT_RANGE, (std::to_string(transfer.resumeFrom) + "-").c_str());
+		}
+		curl_easy_setopt(curl, CURLOPT_URL, StringUtils::ws2s(url).c_str());
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer.responseHeaders);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteData);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+
+		CURLcode res = curl_easy_perform(curl);
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+		curl_slist_free_all(headers);
+		if (res == CURLE_OK && !transfer.started && !startDownload(transfer)) {		// Empty body, the headers were all there was
+			res = CURLE_WRITE_ERROR;
+		}
+		transfer.file.close();
+		if (transfer.rangeMismatch) {
+			fs::remove(transfer.partPath, ec);
+			fs::remove(transfer.validatorPath, ec);
+			continue;
+		}
+
+		long responseCode = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+		if (res == CURLE_OK && responseCode == 416 && transfer.resumeFrom > 0) {
+			// Nothing past the part: either it is already the whole file, or the file got shorter and the part is stale
+			std::string contentRange;
+			if (findHeaderValue(transfer.responseHeaders, "content-range", contentRange) &&
+				contentRange.substr(contentRange.find_last_of('/') + 1) == std::to_string(transfer.resumeFrom)) {
+				responseCode = 200;
+			}
+			else {
+				fs::remove(transfer.partPath, ec);
+				continue;
+			}
+		}
+		if (res != CURLE_OK || (responseCode != 200 && responseCode != 206)) {
+			errorMsg = L"Failed to download file. ";
+			errorMsg += (res != CURLE_OK) ? L"curlError: " + StringUtils::s2ws(curl_easy_strerror(res)) : L"HTTP status " + std::to_wstring(responseCode);
+			const uintmax_t kept = fs::file_size(transfer.partPath, ec);
+			if (!ec && kept > 0 && fs::exists(transfer.validatorPath, ec)) {
+				errorMsg += L". " + std::to_wstring(kept) + L" bytes kept, the next download resumes from there";
+			}
+			return false;
+		}
+		fs::rename(transfer.partPath, outputPath, ec);				// Replaces an older copy in one step
+		if (ec) {
+			errorMsg = L"Failed to open output file: " + outputFilePath + L". " + StringUtils::s2ws(ec.message());
+			return false;
+		}
+		fs::remove(transfer.validatorPath, ec);
+		return true;
 	}
-	curl_easy_cleanup(curl);
-	outputFile.close();
-	return true;
+	errorMsg = L"Failed to download file. The server rejected the resume and the restart";
+	return false;
 }
 
-bool curlFileTransfer::UploadFileToURL(const std::wstring &url, const std::wstring &filePath, std::wstring &errorMsg) {
+/* Open the file and set up the multipart POST on the transfer's handle, ready for curl_easy_perform() or a multi handle */
+bool curlFileTransfer::prepareUpload(UploadTransfer &transfer, const std::string &url_utf8, std::wstring &errorMsg) {
 
-	std::ifstream fileStream(filePath, std::ios::binary);
-	if (!fileStream.is_open()) {
-		errorMsg = filePath + L": file opening failure";
+	CURL* curl = transfer.handle.get();
+	if (!curl) {
+		errorMsg = L"Failed to initialize libcurl";
 		return false;
 	}
-	fileStream.seekg(0, std::ios::end);
-	curl_off_t fileSize = fileStream.tellg();
-	if (fileSize == -1) {
-		errorMsg = L"Failed to get the file size.";
+	transfer.fileStream.open(fs::path(transfer.filePath), std::ios::binary);
+	if (!transfer.fileStream.is_open()) {
+		errorMsg = transfer.filePath + L": file opening failure";
 		return false;
 	}
-	fileStream.seekg(0, std::ios::beg);
-	CURL* curl = curl_easy_init();
-	if (!curl) {
-		errorMsg = L"Failed to initialize libcurl";
+	transfer.fileStream.seekg(0, std::ios::end);
+	curl_off_t fileSize = transfer.fileStream.tellg();
+	if (fileSize == -1) {
+		errorMsg = L"Failed to get the file size.";
 		return false;
 	}
-	curl_mime* mime = curl_mime_init(curl);
-	curl_mimepart* part = curl_mime_addpart(mime);
-	curl_mime_data_cb(part, fileSize, readCallback, nullptr, nullptr, &fileStream);
+	transfer.fileStream.seekg(0, std::ios::beg);
+	transfer.mime = curl_mime_init(curl);
+	curl_mimepart* part = curl_mime_addpart(transfer.mime);
+	curl_mime_data_cb(part, fileSize, readCallback, nullptr, nullptr, &transfer.fileStream);
 
-	const std::string filePath_utf8 = StringUtils::convertWStringToUTF8(filePath);
+	const std::string filePath_utf8 = StringUtils::convertWStringToUTF8(transfer.filePath);
 	curl_mime_name(part, "file");
 	curl_mime_filename(part, filePath_utf8.c_str());
 
-	curl_easy_setopt(curl, CURLOPT_URL, StringUtils::convertWStringToUTF8(url).c_str());
-	curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+	curl_easy_setopt(curl, CURLOPT_URL, url_utf8.c_str());
+	curl_easy_setopt(curl, CURLOPT_MIMEPOST, transfer.mime);
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);		// A rejected upload (4xx/5xx) is an error too
 
 	// Set the callback function for writing response data
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
@@ -141,55 +656,367 @@ bool curlFileTransfer::UploadFileToURL(const std::wstring &url, const std::wstri
 
 	// Enable verbose mode for debugging (optional)
 	// curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+	return true;
+}
+
+bool curlFileTransfer::uploadWholeFile(const std::string &url_utf8, const std::wstring &filePath, std::wstring &errorMsg) {
 
-	int retValue = curl_easy_perform(curl);
-	if (retValue != CURLE_OK) {
-		errorMsg = L"Failed to upload file. curlErrorCode: " + std::to_wstring(retValue);
+	UploadTransfer transfer;
+	transfer.filePath = filePath;
+	if (!prepareUpload(transfer, url_utf8, errorMsg)) {
+		return false;
 	}
-	curl_mime_free(mime);
-	curl_easy_cleanup(curl);
+	CURLcode res = curl_easy_perform(transfer.handle.get());
+	if (res != CURLE_OK) {
+		errorMsg = L"Failed to upload file. curlError: " + StringUtils::s2ws(curl_easy_strerror(res));
+		return false;
+	}
+	return true;
+}
 
-	return (retValue == CURLE_OK);
+int curlFileTransfer::queryUploadOffset(CURL* curl, const std::string &url_utf8, const std::string &uploadId, curl_off_t &offset) {
+
+	CurlHandlePool::instance().reset(curl);
+	std::string responseHeaders;
+	struct curl_slist* headers = curl_slist_append(NULL, ("Upload-Id: " + uploadId).c_str());
+	curl_easy_setopt(curl, CURLOPT_URL, url_utf8.c_str());
+	curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+	curl_easy_setopt(curl, CURLOPT_USERAGENT, "clienthttp (Windows NT; x86)");
+	const CURLcode res = curl_easy_perform(curl);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+	curl_slist_free_all(headers);
+	if (res != CURLE_OK) {
+		return -1;
+	}
+	long responseCode = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+	if (responseCode == 404 || responseCode == 405 || responseCode == 501) {
+		return 0;
+	}
+	if (responseCode / 100 != 2) {
+		return -1;							// 5xx and the like say nothing about chunk support, only that the server is unwell
+	}
+	std::string value;
+	if (!findHeaderValue(responseHeaders, "upload-offset", value)) {
+		return 0;
+	}
+	try {
+		offset = static_cast<curl_off_t>(std::stoll(value));
+	}
+	catch (const std::exception&) {
+		return 0;
+	}
+	return 1;
 }
 
-bool curlFileTransfer::UploadDirectoryToURL(const std::wstring &url, const std::wstring &dirPath, std::wstring &errorMsg, const std::wstring &extensions) {
+bool curlFileTransfer::uploadFileInChunks(const std::string &url_utf8, const std::wstring &filePath, const curl_off_t &fileSize, bool &serverSupportsChunks, std::wstring &errorMsg) {
 
-	std::vector<std::wstring> filesToUpload;
-	std::vector<std::string> extensions_vec = StringUtils::extract_items_from_str(StringUtils::ws2s(extensions), ",");
+	serverSupportsChunks = true;
 	std::error_code ec;
+	const fs::path path(filePath);
+	const long long modified = static_cast<long long>(fs::last_write_time(path, ec).time_since_epoch().count());
+	const std::string filePath_utf8 = StringUtils::convertWStringToUTF8(filePath);
+	auto fileChanged = [&path, &fileSize, &modified]() {
+		std::error_code statError;
+		const uintmax_t size = fs::file_size(path, statError);
+		const long long written = static_cast<long long>(fs::last_write_time(path, statError).time_since_epoch().count());
+		return statError || static_cast<curl_off_t>(size) != fileSize || written != modified;
+	};
 
-	for (const auto& entry : fs::recursive_directory_iterator(dirPath, fs::directory_options::skip_permission_denied, ec)) {
-		std::wstring filePath;
-		auto fileType = fs::status(entry, ec).type();    // To get error_code status
-		if (!ec) {
-			if (fileType == fs::file_type::regular) {
-				filePath = entry.path().wstring();
-				if (extensions.empty()) {
-					filesToUpload.push_back(filePath);
-				}
-				else {
-					std::string extension = entry.path().extension().string();
-					for (auto& ext : extensions_vec) {
-						if (ext == extension) {
-							filesToUpload.push_back(filePath);
-							break;
-						}
-					}
-				}
+	removeExpiredJournals(uploadJournalMaxAge);
+	UploadJournal journal(filePath_utf8);
+	if (!journal.load() || journal.fileSize != fileSize || journal.modified != modified) {
+		journal.remove();								// Stale, if there was one
+		journal.uploadId = newUploadId();				// New or changed file, the server's copy of an older upload is of no use
+		journal.fileSize = fileSize;
+		journal.modified = modified;
+		journal.offset = 0;
+	}
+
+	PooledCurlHandle handle;
+	CURL* curl = handle.get();
+	if (!curl) {
+		errorMsg = L"Failed to initialize libcurl";
+		return false;
+	}
+	curl_off_t offset = 0;
+	int query = queryUploadOffset(curl, url_utf8, journal.uploadId, offset);
+	for (int attempt = 1; query < 0 && attempt <= maxChunkRetries; ++attempt) {
+		std::this_thread::sleep_for(std::chrono::seconds(attempt));
+		query = queryUploadOffset(curl, url_utf8, journal.uploadId, offset);
+	}
+	if (query == 0) {
+		serverSupportsChunks = false;
+		journal.remove();
+		return false;
+	}
+	if (query < 0) {
+		errorMsg = L"Failed to upload file. The data server didn't answer the upload offset query";
+		return false;
+	}
+	journal.save();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		errorMsg = filePath + L": file opening failure";
+		return false;
+	}
+	char* escapedName = curl_easy_escape(curl, filePath_utf8.c_str(), static_cast<int>(filePath_utf8.length()));
+	const std::string uploadName = (escapedName != nullptr) ? escapedName : "";
+	curl_free(escapedName);
+
+	std::vector<char> chunk(uploadChunkSize);
+	int consecutiveFailures = 0;
+	while (offset < fileSize) {
+		const size_t chunkLength = static_cast<size_t>(std::min<curl_off_t>(static_cast<curl_off_t>(uploadChunkSize), fileSize - offset));
+		if (fileChanged()) {
+			journal.remove();							// The server holds a mix of old and new content, the next upload starts over
+			errorMsg = filePath + L": changed during the upload at offset " + std::to_wstring(offset);
+			return false;
+		}
+		file.clear();
+		file.seekg(static_cast<std::streamoff>(offset));
+		if (!file.read(chunk.data(), static_cast<std::streamsize>(chunkLength))) {
+			errorMsg = filePath + L": read failure at offset " + std::to_wstring(offset);
+			return false;
+		}
+
+		CurlHandlePool::instance().reset(curl);
+		std::string responseHeaders;
+		struct curl_slist* headers = NULL;
+		headers = curl_slist_append(headers, ("Upload-Id: " + journal.uploadId).c_str());
+		headers = curl_slist_append(headers, ("Upload-Offset: " + std::to_string(offset)).c_str());
+		headers = curl_slist_append(headers, ("Upload-Length: " + std::to_string(fileSize)).c_str());
+		headers = curl_slist_append(headers, ("Upload-Name: " + uploadName).c_str());
+		headers = curl_slist_append(headers, ("Upload-Checksum: crc32 " + toHex(crc32(chunk.data(), chunkLength), 8)).c_str());
+		headers = curl_slist_append(headers, "Content-Type: application/offset+octet-stream");
+		headers = curl_slist_append(headers, "Expect:");		// No 100-continue round trip per chunk
+		curl_easy_setopt(curl, CURLOPT_URL, url_utf8.c_str());
+		curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, chunk.data());
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(chunkLength));
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+		curl_easy_setopt(curl, CURLOPT_USERAGENT, "clienthttp (Windows NT; x86)");
+		const CURLcode res = curl_easy_perform(curl);
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+		curl_slist_free_all(headers);
+
+		long responseCode = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+		std::string value;
+		if (res == CURLE_OK && responseCode / 100 == 2 && findHeaderValue(responseHeaders, "upload-offset", value) &&
+			value == std::to_string(offset + static_cast<curl_off_t>(chunkLength))) {
+			offset += static_cast<curl_off_t>(chunkLength);
+			journal.offset = offset;
+			journal.save();
+			consecutiveFailures = 0;
+			continue;
+		}
+		if (++consecutiveFailures > maxChunkRetries) {
+			errorMsg = L"Upload interrupted at " + std::to_wstring(offset) + L" of " + std::to_wstring(fileSize) + L" bytes, the next upload of " +
+				filePath + L" resumes from there";
+			if (res != CURLE_OK) {
+				errorMsg += L". curlError: " + StringUtils::s2ws(curl_easy_strerror(res));
 			}
+			return false;
 		}
-		else {
-			continue;   // Skip the file which causes error
+		std::this_thread::sleep_for(std::chrono::seconds(consecutiveFailures));		// Back off, then ask the server where to continue
+		curl_off_t serverOffset = 0;
+		if (queryUploadOffset(curl, url_utf8, journal.uploadId, serverOffset) == 1 && serverOffset >= 0 && serverOffset <= fileSize) {
+			offset = serverOffset;
 		}
 	}
-	if (filesToUpload.empty()) {
+	journal.remove();
+	return true;
+}
+
+bool curlFileTransfer::uploadLargeFile(const std::string &url_utf8, const std::wstring &filePath, const curl_off_t &fileSize, std::wstring &errorMsg) {
+
+	bool serverSupportsChunks = true;
+	if (uploadFileInChunks(url_utf8, filePath, fileSize, serverSupportsChunks, errorMsg)) {
+		return true;
+	}
+	return serverSupportsChunks ? false : uploadWholeFile(url_utf8, filePath, errorMsg);
+}
+
+bool curlFileTransfer::UploadFileToURL(const std::wstring &url, const std::wstring &filePath, std::wstring &errorMsg) {
+
+	const std::string url_utf8 = StringUtils::convertWStringToUTF8(url);
+	std::error_code ec;
+	const uintmax_t fileSize = fs::file_size(fs::path(filePath), ec);
+	if (!ec && fileSize >= static_cast<uintmax_t>(chunkedUploadThreshold)) {
+		return uploadLargeFile(url_utf8, filePath, static_cast<curl_off_t>(fileSize), errorMsg);
+	}
+	return uploadWholeFile(url_utf8, filePath, errorMsg);
+}
+
+bool curlFileTransfer::UploadDirectoryToURL(const std::wstring &url, const std::wstring &dirPath, std::wstring &errorMsg, const std::wstring &extensions) {
+
+	PooledMultiHandle multiHandle;							// Pooled, its connection cache outlives this upload
+	CURLM* multi = multiHandle.get();
+	if (!multi) {
+		errorMsg = L"Failed to initialize libcurl";
 		return false;
 	}
+	// The multi handle keeps one connection cache for its transfers, the cap keeps all of them on warm connections
+	curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(maxConcurrentUploads));
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, static_cast<long>(maxConcurrentUploads));	// Kept for the next upload once these are done
 
-	for (const auto& filePath : filesToUpload) {
-		if (!UploadFileToURL(url, filePath, errorMsg)) {      // Upload a file            
-			errorMsg = L"Couldn't upload: " + filePath;
+	std::unordered_set<std::wstring> wantedExtensions;
+	for (const auto& extension : StringUtils::extract_items_from_str(StringUtils::ws2s(extensions), ",")) {
+		if (!extension.empty()) {				// An empty list yields one empty item, which means "any extension"
+			wantedExtensions.insert(StringUtils::s2ws(extension));
 		}
 	}
-	return true;
-}
\ No newline at end of file
+
+	// The walk runs ahead of the uploads by at most uploadQueueCapacity files, whatever the size of the tree
+	UploadWorkQueue workQueue(uploadQueueCapacity);
+	std::atomic<size_t> filesFound{ 0 };
+	std::thread walker([&]() {
+		std::error_code ec;
+		for (fs::recursive_directory_iterator entry(dirPath, fs::directory_options::skip_permission_denied, ec), end; !ec && entry != end; entry.increment(ec)) {
+			if (workQueue.isCancelled()) {
+				break;								// Uploads gave up, don't finish walking a large tree of non-matching files
+			}
+			std::error_code statusError;
+			if (!entry->is_regular_file(statusError) || statusError) {		// Uses the status cached by the walk where the platform provides one
+				continue;
+			}
+			if (!wantedExtensions.empty() && wantedExtensions.count(entry->path().extension().wstring()) == 0) {
+				continue;
+			}
+			++filesFound;
+			if (!workQueue.push(entry->path().wstring())) {
+				break;								// Uploads gave up
+			}
+			curl_multi_wakeup(multi);
+		}
+		workQueue.close();
+		curl_multi_wakeup(multi);
+	});
+
+	const std::string url_utf8 = StringUtils::convertWStringToUTF8(url);
+	std::unordered_map<CURL*, std::unique_ptr<UploadTransfer>> running;
+	std::vector<std::wstring> failures;						/* First maxReportedFailures only */
+	size_t failed = 0;
+	size_t uploaded = 0;
+	auto recordFailure = [&failures, &failed](const std::wstring& failure) {
+		if (failures.size() < maxReportedFailures) {
+			failures.push_back(failure);
+		}
+		++failed;
+	};
+
+	std::vector<std::wstring> largeFiles;					/* Only paths, the walk stays bounded by what fits the pipe */
+
+	// Keep maxConcurrentUploads files in flight, each failure is recorded and the rest carry on
+	bool walkFinished = false;
+	while (!walkFinished || !running.empty()) {
+		while (!walkFinished && running.size() < maxConcurrentUploads) {
+			auto transfer = std::make_unique<UploadTransfer>();
+			// Nothing in flight: sleep on the walk, otherwise only take what it has already found
+			const UploadWorkQueue::PopResult popped = running.empty() ? workQueue.waitPop(transfer->filePath) : workQueue.tryPop(transfer->filePath);
+			if (popped == UploadWorkQueue::PopResult::Finished) {
+				walkFinished = true;
+			}
+			if (popped != UploadWorkQueue::PopResult::Item) {
+				break;
+			}
+			std::error_code ec;
+			const uintmax_t fileSize = fs::file_size(fs::path(transfer->filePath), ec);
+			if (!ec && fileSize >= static_cast<uintmax_t>(chunkedUploadThreshold)) {
+				largeFiles.push_back(std::move(transfer->filePath));		// Resumable, one after another once the small files are done
+				continue;
+			}
+			std::wstring transferError;
+			if (!prepareUpload(*transfer, url_utf8, transferError)) {
+				recordFailure(transferError);
+				continue;
+			}
+			CURL* curl = transfer->handle.get();
+			curl_multi_add_handle(multi, curl);
+			running.emplace(curl, std::move(transfer));
+		}
+		if (running.empty()) {
+			continue;
+		}
+		int stillRunning = 0;
+		CURLMcode mc = curl_multi_perform(multi, &stillRunning);
+		if (mc == CURLM_OK && stillRunning > 0) {
+			mc = curl_multi_poll(multi, NULL, 0, 1000, NULL);		// Also woken by the walk finding a file
+		}
+		if (mc != CURLM_OK) {
+			for (auto& transfer : running) {
+				recordFailure(transfer.second->filePath + L": " + StringUtils::s2ws(curl_multi_strerror(mc)));
+				curl_multi_remove_handle(multi, transfer.first);
+			}
+			running.clear();
+			workQueue.cancel();
+			break;
+		}
+		int queuedMessages = 0;
+		while (CURLMsg* msg = curl_multi_info_read(multi, &queuedMessages)) {
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			const auto transfer = running.find(msg->easy_handle);
+			if (msg->data.result == CURLE_OK) {
+				++uploaded;
+			}
+			else {
+				recordFailure(transfer->second->filePath + L": " + StringUtils::s2ws(curl_easy_strerror(msg->data.result)));
+			}
+			curl_multi_remove_handle(multi, msg->easy_handle);
+			running.erase(transfer);			// Handle goes back to the pool
+		}
+	}
+	walker.join();
+
+	for (const auto& filePath : largeFiles) {
+		std::wstring transferError;
+		std::error_code ec;
+		const uintmax_t fileSize = fs::file_size(fs::path(filePath), ec);
+		if (ec) {
+			recordFailure(filePath + L": " + StringUtils::s2ws(ec.message()));
+		}
+		else if (uploadLargeFile(url_utf8, filePath, static_cast<curl_off_t>(fileSize), transferError)) {
+			++uploaded;
+		}
+		else {
+			recordFailure(filePath + L": " + transferError);
+		}
+	}
+
+	if (filesFound == 0) {
+		errorMsg = L"No files to upload";
+		return false;
+	}
+	if (failed == 0 && uploaded == filesFound) {
+		return true;
+	}
+	const size_t notAttempted = filesFound - uploaded - failed;
+	errorMsg = L"Uploaded " + std::to_wstring(uploaded) + L" of " + std::to_wstring(filesFound.load()) + L" files";
+	if (notAttempted > 0) {
+		errorMsg += L", " + std::to_wstring(notAttempted) + L" not attempted";
+	}
+	if (failed > 0) {
+		errorMsg += L". Failed:";
+		for (const auto& failure : failures) {
+			errorMsg += L" [" + failure + L"]";
+		}
+		if (failed > failures.size()) {
+			errorMsg += L" ... and " + std::to_wstring(failed - failures.size()) + L" more";
+		}
+	}
+	return false;
+}
+
+void curlFileTransfer::ShutdownModule(void) {
+	CurlHandlePool::shutdown();
+}
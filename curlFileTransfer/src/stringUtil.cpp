@@ -20,7 +20,7 @@
 
 
 #include "stringUtil.h"
-#include <codecvt>
+#include "utfTranscoder.h"
 
 bool StringUtils::endsWith(const std::wstring_view &str, const std::wstring_view &suffix) {
 	return str.size() >= suffix.size() && 0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix);
@@ -31,27 +31,15 @@ bool StringUtils::startsWith(const std::wstring_view &str, const std::wstring_vi
 }
 
 std::string StringUtils::ws2s(const std::wstring& wstr) {
-
-	using convert_typeX = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_typeX, wchar_t> converterX;
-
-	try { return converterX.to_bytes(wstr); }
-	catch (const std::range_error& e) { return e.what(); }
+	return UtfTranscoder::wideToUtf8(wstr);
 }
 
 std::wstring StringUtils::s2ws(const std::string& str) {
-
-	using convert_typeX = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_typeX, wchar_t> converterX;
-
-	try { return converterX.from_bytes(str); }
-	catch (const std::range_error& e) { return converterX.from_bytes(e.what()); }
+	return UtfTranscoder::utf8ToWide(str);
 }
 
 std::string StringUtils::convertWStringToUTF8(const std::wstring& wstr) {
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>, wchar_t> utf8_converter;
-//	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> utf8_converter;
-	return utf8_converter.to_bytes(wstr);
+	return UtfTranscoder::wideToUtf8(wstr);
 }
 
 std::vector<std::string> StringUtils::extract_items_from_str(const std::string& input_str, const std::string& delimiter) {
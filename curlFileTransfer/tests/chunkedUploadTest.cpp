@@ -0,0 +1,41 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+/*
+	Runs one UploadFileToURL() for chunkedUploadTest.py, which plays the data server.
+	Usage: chunkedUploadTest <url> <file>. Exits with 0 if the upload succeeded, the error message goes to stdout.
+*/
+#include "fileTransferService.h"
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+
+	if (argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <url> <file>" << std::endl;
+		return 2;
+	}
+	std::wstring errorMsg;
+	const bool uploaded = curlFileTransfer::UploadFileToURL(StringUtils::s2ws(argv[1]), StringUtils::s2ws(argv[2]), errorMsg);
+	if (!uploaded) {
+		std::cout << StringUtils::convertWStringToUTF8(errorMsg) << std::endl;
+	}
+	curlFileTransfer::ShutdownModule();
+	return uploaded ? 0 : 1;
+}
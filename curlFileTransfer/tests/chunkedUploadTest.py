@@ -0,0 +1,235 @@
+# Copyright (c) Nouman Tajik [github.com/tajiknomi]
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Resumable chunked uploads against a mock data server (the HEAD/PATCH protocol in fileTransferService.cpp).
+#   python chunkedUploadTest.py <path to the chunkedUploadTest executable>
+# The server runs as a separate process, so "killing" it mid-upload is a real process exit.
+# An abandoned upload waits out its retries (about 15 s) before the client gives up.
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import zlib
+import http.server
+
+CHUNK_SIZE = 8 * 1024 * 1024                    # curlFileTransfer::uploadChunkSize
+FILE_SIZE = 64 * 1024 * 1024 + 3 * 1024 * 1024  # Over curlFileTransfer::chunkedUploadThreshold, 9 chunks
+
+
+# ================================ Mock data server ================================
+
+def serve(storeDir, dieAfterPatches, failedHeads, headStatus):
+    patches = [0]
+    heads = [0]
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def reply(self, status, offset=None):
+            self.send_response(status)
+            if offset is not None:
+                self.send_header("Upload-Offset", str(offset))
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+
+        def storedPath(self):
+            return os.path.join(storeDir, os.path.basename(self.headers["Upload-Id"]))
+
+        def storedSize(self):
+            path = self.storedPath()
+            return os.path.getsize(path) if os.path.exists(path) else 0
+
+        def do_HEAD(self):
+            heads[0] += 1
+            if headStatus != 200:
+                print("HEAD", self.headers["Upload-Id"], headStatus, flush=True)
+                return self.reply(headStatus)
+            if heads[0] <= failedHeads:
+                print("HEAD", self.headers["Upload-Id"], 503, flush=True)
+                return self.reply(503)
+            print("HEAD", self.headers["Upload-Id"], self.storedSize(), flush=True)
+            self.reply(200, self.storedSize())
+
+        def do_PATCH(self):
+            body = self.rfile.read(int(self.headers["Content-Length"]))
+            offset = self.storedSize()
+            checksum = int(self.headers["Upload-Checksum"].split()[1], 16)
+            accepted = int(self.headers["Upload-Offset"]) == offset and checksum == zlib.crc32(body)
+            if accepted:
+                with open(self.storedPath(), "ab") as stored:
+                    stored.write(body)
+                offset += len(body)
+            patches[0] += 1
+            print("PATCH", self.headers["Upload-Id"], self.headers["Upload-Offset"], len(body), accepted, flush=True)
+            if patches[0] == dieAfterPatches:
+                os._exit(0)                     # Stored, but the client never hears about it
+            self.reply(204 if accepted else 409, offset)
+
+        def do_POST(self):
+            self.rfile.read(int(self.headers["Content-Length"]))
+            print("POST", flush=True)
+            self.reply(200)
+
+        def log_message(self, *args):
+            pass
+
+    server = http.server.HTTPServer(("127.0.0.1", 0), Handler)
+    print(server.server_address[1], flush=True)
+    server.serve_forever()
+
+
+class MockServer:
+    def __init__(self, storeDir, dieAfterPatches=0, failedHeads=0, headStatus=200):
+        self.process = subprocess.Popen([sys.executable, __file__, "serve", storeDir, str(dieAfterPatches), str(failedHeads), str(headStatus)],
+                                        stdout=subprocess.PIPE, text=True)
+        self.url = "http://127.0.0.1:" + self.process.stdout.readline().strip() + "/upload"
+
+    def stop(self):                             # The requests it served, one (method, upload id, ...) tuple each
+        if self.process.poll() is None:
+            self.process.kill()
+        return [line.split() for line in self.process.communicate()[0].splitlines()]
+
+
+# ================================ Tests ================================
+
+def upload(executable, url, filePath, tempDir):
+    env = dict(os.environ, TMP=tempDir, TEMP=tempDir, TMPDIR=tempDir)       # Keeps the journals where the test can see them
+    result = subprocess.run([executable, url, filePath], stdout=subprocess.PIPE, text=True, env=env, timeout=300)
+    return result.returncode == 0, result.stdout.strip()
+
+
+def journals(tempDir):
+    found = []
+    for directory in os.listdir(tempDir):
+        if directory.startswith("clienthttp-upload-journals-"):
+            found += [name for name in os.listdir(os.path.join(tempDir, directory)) if name.endswith(".journal")]
+    return found
+
+
+def writeTestFile(filePath, seed):
+    block = bytes((seed * 31 + i * 7) & 0xFF for i in range(1024 * 1024))
+    with open(filePath, "wb") as file:
+        for _ in range(FILE_SIZE // len(block)):
+            file.write(block)
+
+
+def check(condition, message):
+    if not condition:
+        raise AssertionError(message)
+
+
+def testKillAndResume(executable, workDir):
+    storeDir, tempDir = os.path.join(workDir, "store"), os.path.join(workDir, "temp")
+    filePath = os.path.join(workDir, "large.bin")
+    writeTestFile(filePath, 1)
+
+    server = MockServer(storeDir, dieAfterPatches=3)
+    uploaded, errorMsg = upload(executable, server.url, filePath, tempDir)
+    firstRun = server.stop()
+    check(not uploaded, "the upload succeeded although the server died")
+    check("resumes from there" in errorMsg, "unexpected error: " + errorMsg)
+    check(len(journals(tempDir)) == 1, "no journal left for the resume")
+
+    server = MockServer(storeDir)
+    uploaded, errorMsg = upload(executable, server.url, filePath, tempDir)
+    secondRun = server.stop()
+    check(uploaded, "the resumed upload failed: " + errorMsg)
+    uploadId = firstRun[0][1]
+    check(secondRun[0] == ["HEAD", uploadId, str(3 * CHUNK_SIZE)], "didn't resume the same upload: " + str(secondRun[0]))
+    check(all(request[0] == "HEAD" or int(request[2]) >= 3 * CHUNK_SIZE for request in secondRun), "resent chunks the server already held")
+    with open(filePath, "rb") as source, open(os.path.join(storeDir, uploadId), "rb") as stored:
+        check(source.read() == stored.read(), "the stored file differs from the source")
+    check(not journals(tempDir), "the journal outlived the finished upload")
+
+
+def testChangedFileStartsOver(executable, workDir):
+    storeDir, tempDir = os.path.join(workDir, "store"), os.path.join(workDir, "temp")
+    filePath = os.path.join(workDir, "large.bin")
+    writeTestFile(filePath, 2)
+
+    server = MockServer(storeDir, dieAfterPatches=2)
+    uploaded, _ = upload(executable, server.url, filePath, tempDir)
+    firstRun = server.stop()
+    check(not uploaded and len(journals(tempDir)) == 1, "expected an interrupted upload with a journal")
+
+    writeTestFile(filePath, 3)                  # Same size, new content and last write time
+    os.utime(filePath, (os.path.getatime(filePath), os.path.getmtime(filePath) + 10))
+    server = MockServer(storeDir)
+    uploaded, errorMsg = upload(executable, server.url, filePath, tempDir)
+    secondRun = server.stop()
+    check(uploaded, "the upload of the changed file failed: " + errorMsg)
+    check(secondRun[0][1] != firstRun[0][1] and secondRun[0][2] == "0", "resumed the upload of the old content: " + str(secondRun[0]))
+    with open(filePath, "rb") as source, open(os.path.join(storeDir, secondRun[0][1]), "rb") as stored:
+        check(source.read() == stored.read(), "the stored file differs from the source")
+    check(not journals(tempDir), "the stale journal was left behind")
+
+
+def testUnavailableServerIsRetried(executable, workDir):
+    storeDir, tempDir = os.path.join(workDir, "store"), os.path.join(workDir, "temp")
+    filePath = os.path.join(workDir, "large.bin")
+    writeTestFile(filePath, 4)
+
+    server = MockServer(storeDir, failedHeads=2)
+    uploaded, errorMsg = upload(executable, server.url, filePath, tempDir)
+    requests = server.stop()
+    check(uploaded, "the upload failed: " + errorMsg)
+    check(not any(request[0] == "POST" for request in requests), "a 503 was taken for a server without chunked uploads")
+    check(sum(request[0] == "PATCH" for request in requests) == (FILE_SIZE + CHUNK_SIZE - 1) // CHUNK_SIZE, "unexpected chunk count")
+
+
+def testServerWithoutChunksGetsPost(executable, workDir):
+    storeDir, tempDir = os.path.join(workDir, "store"), os.path.join(workDir, "temp")
+    filePath = os.path.join(workDir, "large.bin")
+    writeTestFile(filePath, 5)
+
+    server = MockServer(storeDir, headStatus=405)
+    uploaded, errorMsg = upload(executable, server.url, filePath, tempDir)
+    requests = server.stop()
+    check(uploaded, "the upload failed: " + errorMsg)
+    check([request[0] for request in requests] == ["HEAD", "POST"], "expected a single multipart POST: " + str(requests))
+    check(not journals(tempDir), "a journal was left for a server without chunked uploads")
+
+
+def main():
+    if len(sys.argv) == 6 and sys.argv[1] == "serve":
+        return serve(sys.argv[2], int(sys.argv[3]), int(sys.argv[4]), int(sys.argv[5]))
+    if len(sys.argv) != 2:
+        print("Usage: " + sys.argv[0] + " <chunkedUploadTest executable>")
+        return 2
+    failures = 0
+    for test in (testKillAndResume, testChangedFileStartsOver, testUnavailableServerIsRetried, testServerWithoutChunksGetsPost):
+        workDir = tempfile.mkdtemp(prefix="chunkedUploadTest-")
+        os.makedirs(os.path.join(workDir, "store"))
+        os.makedirs(os.path.join(workDir, "temp"))
+        try:
+            test(sys.argv[1], workDir)
+            print("PASS", test.__name__, flush=True)
+        except AssertionError as error:
+            print("FAIL", test.__name__ + ":", error, flush=True)
+            failures += 1
+        finally:
+            shutil.rmtree(workDir, ignore_errors=True)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
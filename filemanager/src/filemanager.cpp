@@ -19,19 +19,14 @@
 // SOFTWARE. 
 
 #include "filemanager.h"
-#include <codecvt>
+#include "utfTranscoder.h"
 #include "json.h"
 
 /* ================================ PRIVATE FUNCTIONS ================================*/
 
 // std::string to std::wstring
 std::wstring s2ws(const std::string& str) {
-
-	using convert_typeX = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_typeX, wchar_t> converterX;
-
-	try { return converterX.from_bytes(str); }
-	catch (const std::range_error& e) { return converterX.from_bytes(e.what()); }
+	return UtfTranscoder::utf8ToWide(str);
 }
 
 // Extract the filename from the input path
@@ -20,7 +20,7 @@
 
 
 #include "json.h"
-#include <codecvt>
+#include "utfTranscoder.h"
 #include <iostream>
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
@@ -30,14 +30,11 @@
 /* ================================ PRIVATE ================================ */
 
 std::string JsonUtil::wstring_to_utf8(const std::wstring& wstr) {
-	std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-	return converter.to_bytes(wstr);
+	return UtfTranscoder::wideToUtf8(wstr);
 }
 
 std::wstring JsonUtil::utf8_to_wstring(const std::string& str) {
-
-	std::wstring_convert<std::codecvt_utf8<wchar_t>> myconv;
-	return myconv.from_bytes(str);
+	return UtfTranscoder::utf8ToWide(str);
 }
 
 
@@ -65,9 +62,7 @@ std::wstring JsonUtil::to_json(const std::vector<std::wstring>& data) {
 
 std::vector<std::wstring> JsonUtil::from_json(const std::wstring& jsonData) {
 
-	// Convert the input jsonData (std::wstring) to UTF-8 encoded std::string
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	std::string utf8jsonData = converter.to_bytes(jsonData);
+	std::string utf8jsonData = wstring_to_utf8(jsonData);
 	rapidjson::Document document;
 	document.Parse(utf8jsonData.c_str());
 	if (document.HasParseError()) {
@@ -89,10 +84,8 @@ std::vector<std::wstring> JsonUtil::from_json(const std::wstring& jsonData) {
 
 std::wstring JsonUtil::extractValue(const std::wstring& jsonData, const std::wstring& key) {
 
-	// Convert the input jsonData and key to UTF-8 encoded std::string
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	std::string utf8jsonData = converter.to_bytes(jsonData);
-	std::string utf8key = converter.to_bytes(key);
+	std::string utf8jsonData = wstring_to_utf8(jsonData);
+	std::string utf8key = wstring_to_utf8(key);
 	rapidjson::Document document;
 	document.Parse(utf8jsonData.c_str());
 	if (!document.IsObject()) {
@@ -113,31 +106,55 @@ std::wstring JsonUtil::extractValue(const std::wstring& jsonData, const std::wst
 	return wstringValue;
 }
 
+static void collectStringMembers(const rapidjson::Value& object, std::unordered_map<std::string, std::string>& members) {
+	members.reserve(object.MemberCount());
+	for (auto it = object.MemberBegin(); it != object.MemberEnd(); ++it) {
+		if (it->value.IsString()) {			// Non-string members are of no use to a job
+			members.emplace(std::string(it->name.GetString(), it->name.GetStringLength()),
+				std::string(it->value.GetString(), it->value.GetStringLength()));
+		}
+	}
+}
+
+bool JsonUtil::extractStringMembersOfEach(const std::string& utf8JsonData, std::vector<std::unordered_map<std::string, std::string>>& objects) {
+	rapidjson::Document document;
+	document.Parse(utf8JsonData.data(), utf8JsonData.length());
+	if (document.IsObject()) {
+		objects.emplace_back();
+		collectStringMembers(document, objects.back());
+		return true;
+	}
+	if (!document.IsArray()) {
+		return false;
+	}
+	objects.reserve(objects.size() + document.Size());
+	for (const auto& element : document.GetArray()) {
+		if (element.IsObject()) {			// Anything else in the array is skipped
+			objects.emplace_back();
+			collectStringMembers(element, objects.back());
+		}
+	}
+	return true;
+}
+
 std::wstring JsonUtil::appendKeyValue(const std::wstring& jsonData, const std::wstring& key, const std::wstring& value) {
-	// Convert the input jsonData, key, and value to UTF-8 encoded std::string
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	std::string utf8jsonData = converter.to_bytes(jsonData);
-	std::string utf8key = converter.to_bytes(key);
-	std::string utf8value = converter.to_bytes(value);
+	return utf8_to_wstring(appendKeyValue(wstring_to_utf8(jsonData), wstring_to_utf8(key), wstring_to_utf8(value)));
+}
+
+std::string JsonUtil::appendKeyValue(const std::string& utf8JsonData, const std::string& key, const std::string& value) {
 	rapidjson::Document document;
-	document.Parse(utf8jsonData.c_str());
+	document.Parse(utf8JsonData.c_str(), utf8JsonData.length());
 	if (!document.IsObject()) {
 		// Handle error if needed
-		return jsonData;
+		return utf8JsonData;
 	}
-	rapidjson::Value jsonValue(utf8value.c_str(), document.GetAllocator());
 	rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
-	rapidjson::Value jsonKey(utf8key.c_str(), allocator);
+	rapidjson::Value jsonKey(key.c_str(), static_cast<rapidjson::SizeType>(key.length()), allocator);
+	rapidjson::Value jsonValue(value.c_str(), static_cast<rapidjson::SizeType>(value.length()), allocator);
 	document.AddMember(jsonKey, jsonValue, allocator);
 
 	rapidjson::StringBuffer buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	document.Accept(writer);
-
-	// Convert the UTF-8 encoded JSON string to std::wstring
-	std::string utf8Result = buffer.GetString();
-	std::wstring wResult = utf8_to_wstring(utf8Result);
-	return wResult;
+	return std::string(buffer.GetString(), buffer.GetSize());
 }
-
-
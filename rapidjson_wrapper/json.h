@@ -22,6 +22,7 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 class JsonUtil {
 
@@ -39,6 +40,10 @@ public:
 	// Extract <value> from json using <key>
 	static std::wstring extractValue(const std::wstring& jsonData, const std::wstring& key);
 
+	// Parse a UTF-8 json object, or array of objects, once and collect the string members of each; false if it is neither
+	static bool extractStringMembersOfEach(const std::string& utf8JsonData, std::vector<std::unordered_map<std::string, std::string>>& objects);
+
 	// Insert a key-value pair into an existing JSON string
 	static std::wstring appendKeyValue(const std::wstring& jsonData, const std::wstring& key, const std::wstring& value);
+	static std::string appendKeyValue(const std::string& utf8JsonData, const std::string& key, const std::string& value);	// All UTF-8
 };
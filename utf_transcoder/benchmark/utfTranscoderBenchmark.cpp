@@ -0,0 +1,129 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+/*
+	utf_transcoder against the std::wstring_convert<std::codecvt_utf8<wchar_t>> helpers it replaced.
+	Two workloads: many short strings (paths, JSON values), converted through a fresh converter per call as the old
+	s2ws/ws2s did, and one large buffer. Build with -DUTF_TRANSCODER_BUILD_BENCHMARK=ON, run the Release binary:
+	    utfTranscoderBenchmark [iterations]
+*/
+
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+#include "utfTranscoder.h"
+#include <codecvt>
+#include <locale>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+
+	// The converters every target used before utf_transcoder
+	std::wstring baselineUtf8ToWide(const std::string &utf8) {
+		std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+		return converter.from_bytes(utf8);
+	}
+
+	std::string baselineWideToUtf8(const std::wstring &wide) {
+		std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+		return converter.to_bytes(wide);
+	}
+
+	/* Random text from the given code points; kept inside the BMP so the baseline (UCS-2 on Windows) converts it too */
+	std::string makeText(const size_t &codePoints, const std::vector<wchar_t> &alphabet, std::mt19937 &generator) {
+		std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+		std::wstring wide;
+		wide.reserve(codePoints);
+		for (size_t i = 0; i < codePoints; ++i) {
+			wide += alphabet[pick(generator)];
+		}
+		return UtfTranscoder::wideToUtf8(wide);
+	}
+
+	template <typename Function>
+	double bestOf(const int &iterations, Function function) {
+		double best = 0;
+		for (int i = 0; i < iterations; ++i) {
+			const auto start = std::chrono::steady_clock::now();
+			function();
+			const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = (i == 0 || elapsed_ms < best) ? elapsed_ms : best;
+		}
+		return best;
+	}
+
+	size_t sink = 0;			/* Keeps the optimizer from dropping the conversions */
+
+	bool runWorkload(const std::string &name, const std::vector<std::string> &utf8Strings, const int &iterations) {
+		std::vector<std::wstring> wideStrings;
+		size_t bytes = 0;
+		for (const auto &utf8 : utf8Strings) {
+			wideStrings.push_back(UtfTranscoder::utf8ToWide(utf8));
+			bytes += utf8.length();
+			if (wideStrings.back() != baselineUtf8ToWide(utf8) || UtfTranscoder::wideToUtf8(wideStrings.back()) != baselineWideToUtf8(wideStrings.back())) {
+				std::cerr << name << ": output differs from the codecvt baseline" << std::endl;
+				return false;
+			}
+		}
+		const double baselineDecode = bestOf(iterations, [&] { for (const auto &s : utf8Strings) { sink += baselineUtf8ToWide(s).length(); } });
+		const double decode = bestOf(iterations, [&] { for (const auto &s : utf8Strings) { sink += UtfTranscoder::utf8ToWide(s).length(); } });
+		const double baselineEncode = bestOf(iterations, [&] { for (const auto &s : wideStrings) { sink += baselineWideToUtf8(s).length(); } });
+		const double encode = bestOf(iterations, [&] { for (const auto &s : wideStrings) { sink += UtfTranscoder::wideToUtf8(s).length(); } });
+
+		std::cout << std::fixed << std::setprecision(2) << name << " (" << utf8Strings.size() << " strings, " << bytes / 1024 << " KB)\n"
+			<< "  utf8ToWide  " << std::setw(9) << decode << " ms   codecvt " << std::setw(9) << baselineDecode << " ms   x" << baselineDecode / decode << "\n"
+			<< "  wideToUtf8  " << std::setw(9) << encode << " ms   codecvt " << std::setw(9) << baselineEncode << " ms   x" << baselineEncode / encode << "\n";
+		return true;
+	}
+}
+
+int main(int argc, char **argv) {
+
+	const int iterations = (argc > 1) ? std::max(1, std::atoi(argv[1])) : 5;
+	std::mt19937 generator(42);
+
+	std::vector<wchar_t> ascii;
+	for (wchar_t c = 0x20; c < 0x7F; ++c) {
+		ascii.push_back(c);
+	}
+	std::vector<wchar_t> mixed{ ascii };						// Latin text with Cyrillic and CJK mixed in
+	for (wchar_t c = 0x0410; c < 0x0450; ++c) {
+		mixed.push_back(c);
+	}
+	for (wchar_t c = 0x4E00; c < 0x4E40; ++c) {
+		mixed.push_back(c);
+	}
+
+	bool matches = true;
+	for (const auto &alphabet : { std::make_pair(std::string("ascii"), ascii), std::make_pair(std::string("mixed"), mixed) }) {
+		std::vector<std::string> shortStrings;
+		for (int i = 0; i < 100000; ++i) {
+			shortStrings.push_back(makeText(16 + i % 64, alphabet.second, generator));
+		}
+		matches = runWorkload(alphabet.first + ", short", shortStrings, iterations) && matches;
+		matches = runWorkload(alphabet.first + ", one buffer", { makeText(16 * 1024 * 1024, alphabet.second, generator) }, iterations) && matches;
+	}
+	return (matches && sink != 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,357 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#include "utfTranscoder.h"
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF_SSE2
+#include <emmintrin.h>
+#endif
+
+static constexpr char32_t replacementCharacter{ 0xFFFD };
+static constexpr bool wideIsUtf16{ sizeof(wchar_t) == 2 };
+
+/* ================================ PRIVATE ================================ */
+
+/* Length of the ASCII run at the start of s */
+static size_t asciiPrefix(const unsigned char *s, const size_t &length) {
+	size_t i = 0;
+#ifdef UTF_SSE2
+	for (; i + 16 <= length; i += 16) {
+		if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i))) != 0) {
+			break;						// The scalar loop finds the exact position
+		}
+	}
+#endif
+	while (i < length && s[i] < 0x80) {
+		++i;
+	}
+	return i;
+}
+
+/* Length of the ASCII run at the start of w */
+static size_t asciiPrefix(const wchar_t *w, const size_t &length) {
+	size_t i = 0;
+#ifdef UTF_SSE2
+	constexpr size_t unitsPerVector = 16 / sizeof(wchar_t);
+	const __m128i highBits = wideIsUtf16 ? _mm_set1_epi16(static_cast<short>(0xFF80)) : _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+	for (; i + unitsPerVector <= length; i += unitsPerVector) {
+		const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(units, highBits), _mm_setzero_si128())) != 0xFFFF) {
+			break;
+		}
+	}
+#endif
+	while (i < length && static_cast<uint32_t>(w[i]) < 0x80) {
+		++i;
+	}
+	return i;
+}
+
+/* Decodes one code point, returns the bytes consumed (at least 1). Ill-formed input yields U+FFFD for the maximal bad prefix */
+static size_t decodeUtf8(const unsigned char *s, const size_t &length, char32_t &codePoint) {
+	const unsigned char lead = s[0];
+	if (lead < 0x80) {
+		codePoint = lead;
+		return 1;
+	}
+	size_t needed;
+	unsigned char lowerBound = 0x80, upperBound = 0xBF;		// Range of the 2nd byte, excludes overlongs/surrogates/> U+10FFFF
+	if (lead >= 0xC2 && lead <= 0xDF) { needed = 1; codePoint = lead & 0x1F; }
+	else if (lead >= 0xE0 && lead <= 0xEF) {
+		needed = 2; codePoint = lead & 0x0F;
+		if (lead == 0xE0) { lowerBound = 0xA0; }
+		if (lead == 0xED) { upperBound = 0x9F; }
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4) {
+		needed = 3; codePoint = lead & 0x07;
+		if (lead == 0xF0) { lowerBound = 0x90; }
+		if (lead == 0xF4) { upperBound = 0x8F; }
+	}
+	else {
+		codePoint = replacementCharacter;
+		return 1;
+	}
+	size_t i = 1;
+	for (; i <= needed; ++i) {
+		const unsigned char trail = (i < length) ? s[i] : 0;
+		const bool inRange = (i == 1) ? (trail >= lowerBound && trail <= upperBound) : (trail >= 0x80 && trail <= 0xBF);
+		if (i >= length || !inRange) {
+			codePoint = replacementCharacter;
+			return i;
+		}
+		codePoint = (codePoint << 6) | (trail & 0x3F);
+	}
+	return i;
+}
+
+/* Decodes one code point from a wide string, returns the units consumed */
+static inline size_t decodeWide(const wchar_t *w, const size_t &length, char32_t &codePoint) {
+	const uint32_t unit = static_cast<uint32_t>(w[0]);
+	if (wideIsUtf16) {
+		if (unit >= 0xD800 && unit <= 0xDBFF && length > 1) {
+			const uint32_t low = static_cast<uint32_t>(w[1]);
+			if (low >= 0xDC00 && low <= 0xDFFF) {
+				codePoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+				return 2;
+			}
+		}
+	}
+	codePoint = (unit >= 0xD800 && unit <= 0xDFFF) || unit > 0x10FFFF ? replacementCharacter : unit;
+	return 1;
+}
+
+/* decodeUtf8() with the well-formed 2 and 3 byte forms (Latin, Cyrillic, CJK...) inline, the rest goes the long way */
+static inline size_t decodeUtf8Fast(const unsigned char *s, const size_t &length, char32_t &codePoint) {
+	const unsigned char lead = s[0];
+	if (lead >= 0xC2 && lead <= 0xDF && length >= 2 && (s[1] & 0xC0) == 0x80) {
+		codePoint = (static_cast<char32_t>(lead & 0x1F) << 6) | (s[1] & 0x3F);
+		return 2;
+	}
+	if ((lead & 0xF0) == 0xE0 && length >= 3 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+		codePoint = (static_cast<char32_t>(lead & 0x0F) << 12) | (static_cast<char32_t>(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+		if (codePoint >= 0x800 && (codePoint < 0xD800 || codePoint > 0xDFFF)) {
+			return 3;
+		}
+	}
+	return decodeUtf8(s, length, codePoint);
+}
+
+static size_t utf8Units(const char32_t &codePoint) {
+	return (codePoint < 0x80) ? 1 : (codePoint < 0x800) ? 2 : (codePoint < 0x10000) ? 3 : 4;
+}
+
+static size_t wideUnits(const char32_t &codePoint) {
+	return (wideIsUtf16 && codePoint >= 0x10000) ? 2 : 1;
+}
+
+/* Sizing without the per code point branches of wideLength(): one wchar_t per lead byte, plus the low surrogate of a
+   4 byte form. Exact for well-formed input only, convertUtf8() tells the caller if it wasn't */
+static size_t wideLengthIfWellFormed(const unsigned char *s, const size_t &length) {
+	size_t units = 0;
+	size_t i = 0;
+#ifdef UTF_SSE2
+	const __m128i continuationMax = _mm_set1_epi8(static_cast<char>(0xBF));	// 0x80..0xBF are the signed bytes below -64
+	const __m128i fourByteLeadMin = _mm_set1_epi8(static_cast<char>(0xEF));
+	while (i + 16 <= length) {
+		__m128i counts = _mm_setzero_si128();									// Per byte lane, up to 2 a step, flushed before it can wrap
+		for (int block = 0; block < 127 && i + 16 <= length; ++block, i += 16) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+			counts = _mm_sub_epi8(counts, _mm_cmpgt_epi8(bytes, continuationMax));	// ASCII and leads, -1 each
+			if (wideIsUtf16) {
+				const __m128i unsignedBytes = _mm_xor_si128(bytes, _mm_set1_epi8(static_cast<char>(0x80)));
+				counts = _mm_sub_epi8(counts, _mm_cmpgt_epi8(unsignedBytes, _mm_xor_si128(fourByteLeadMin, _mm_set1_epi8(static_cast<char>(0x80)))));
+			}
+		}
+		const __m128i sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+		units += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+	}
+#endif
+	for (; i < length; ++i) {
+		units += static_cast<size_t>((s[i] & 0xC0) != 0x80) + static_cast<size_t>(wideIsUtf16 && s[i] >= 0xF0);
+	}
+	return units;
+}
+
+/* Same for the UTF-8 length of a wide string, wellFormed is false if there is anything (a surrogate, a value beyond
+   U+10FFFF) it can't size on its own */
+static size_t utf8LengthIfWellFormed(const wchar_t *w, const size_t &length, bool &wellFormed) {
+	size_t bytes = 0;
+	uint32_t suspicious = 0;
+	for (size_t i = 0; i < length; ++i) {
+		const uint32_t unit = static_cast<uint32_t>(w[i]);
+		const uint32_t surrogate = (unit - 0xD800) < 0x800;
+		bytes += 1 + (unit >= 0x80) + (unit >= 0x800) + (unit >= 0x10000) - surrogate;	// A paired surrogate is half of a 4 byte form
+		suspicious |= surrogate | (unit > 0x10FFFF);
+	}
+	wellFormed = (suspicious == 0);
+	return bytes;
+}
+
+/* Decodes utf8 into out, which the caller has sized. With stopAtIllFormed it returns false at the first ill-formed
+   sequence instead of writing U+FFFD, out may then be too small for the rest */
+static bool convertUtf8(const unsigned char *s, const size_t &length, wchar_t *out, const bool &stopAtIllFormed) {
+	size_t i = 0;
+	while (i < length) {
+		size_t ascii = (s[i] < 0x80) ? asciiPrefix(s + i, length - i) : 0;
+#ifdef UTF_SSE2
+		for (; ascii >= 16; ascii -= 16, i += 16) {				// Widen 16 ASCII bytes per step
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i lo16 = _mm_unpacklo_epi8(bytes, zero), hi16 = _mm_unpackhi_epi8(bytes, zero);
+			if (wideIsUtf16) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), lo16);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), hi16);
+			}
+			else {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(lo16, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(lo16, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(hi16, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(hi16, zero));
+			}
+			out += 16;
+		}
+#endif
+		for (; ascii > 0; --ascii) {
+			*out++ = static_cast<wchar_t>(s[i++]);
+		}
+		while (i < length && s[i] >= 0x80) {					// Stay on the scalar path for a run of non-ASCII
+			char32_t codePoint;
+			const size_t consumed = decodeUtf8Fast(s + i, length - i, codePoint);
+			if (stopAtIllFormed && codePoint == replacementCharacter) {
+				return false;									// A literal U+FFFD lands here too, that only costs the exact pass
+			}
+			i += consumed;
+			if (wideIsUtf16 && codePoint >= 0x10000) {
+				*out++ = static_cast<wchar_t>(0xD800 + ((codePoint - 0x10000) >> 10));
+				*out++ = static_cast<wchar_t>(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+			}
+			else {
+				*out++ = static_cast<wchar_t>(codePoint);
+			}
+		}
+	}
+	return true;
+}
+
+
+/* ================================ PUBLIC APIs ================================ */
+
+size_t UtfTranscoder::wideLength(const std::string_view &utf8) {
+	const unsigned char *s = reinterpret_cast<const unsigned char*>(utf8.data());
+	const size_t length = utf8.length();
+	size_t units = 0;
+	size_t i = 0;
+	while (i < length) {
+		const size_t ascii = asciiPrefix(s + i, length - i);
+		units += ascii;
+		i += ascii;
+		if (i < length) {
+			char32_t codePoint;
+			i += decodeUtf8(s + i, length - i, codePoint);
+			units += wideUnits(codePoint);
+		}
+	}
+	return units;
+}
+
+size_t UtfTranscoder::utf8Length(const std::wstring_view &wide) {
+	const wchar_t *w = wide.data();
+	const size_t length = wide.length();
+	size_t bytes = 0;
+	size_t i = 0;
+	while (i < length) {
+		const size_t ascii = asciiPrefix(w + i, length - i);
+		bytes += ascii;
+		i += ascii;
+		if (i < length) {
+			char32_t codePoint;
+			i += decodeWide(w + i, length - i, codePoint);
+			bytes += utf8Units(codePoint);
+		}
+	}
+	return bytes;
+}
+
+std::wstring UtfTranscoder::utf8ToWide(const std::string_view &utf8) {
+	const unsigned char *s = reinterpret_cast<const unsigned char*>(utf8.data());
+	const size_t length = utf8.length();
+	std::wstring wide(wideLengthIfWellFormed(s, length), L'\0');
+	if (!convertUtf8(s, length, &wide[0], true)) {
+		wide.assign(wideLength(utf8), L'\0');					// Ill-formed, the exact count makes room for each U+FFFD
+		convertUtf8(s, length, &wide[0], false);
+	}
+	return wide;
+}
+
+std::string UtfTranscoder::wideToUtf8(const std::wstring_view &wide) {
+	const wchar_t *w = wide.data();
+	const size_t length = wide.length();
+	bool wellFormed;
+	const size_t bytes = utf8LengthIfWellFormed(w, length, wellFormed);
+	std::string utf8(wellFormed ? bytes : utf8Length(wide), '\0');
+	char *out = &utf8[0];
+	size_t i = 0;
+	while (i < length) {
+		size_t ascii = (static_cast<uint32_t>(w[i]) < 0x80) ? asciiPrefix(w + i, length - i) : 0;
+#ifdef UTF_SSE2
+		if (wideIsUtf16) {
+			for (; ascii >= 16; ascii -= 16, i += 16) {			// Narrow 16 ASCII units per step
+				const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+				const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i + 8));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(lo, hi));
+				out += 16;
+			}
+		}
+		else {
+			for (; ascii >= 16; ascii -= 16, i += 16) {
+				const __m128i a = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i + 4)));
+				const __m128i b = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i + 8)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i + 12)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+				out += 16;
+			}
+		}
+#endif
+		for (; ascii > 0; --ascii) {
+			*out++ = static_cast<char>(w[i++]);
+		}
+		while (i < length && static_cast<uint32_t>(w[i]) >= 0x80) {	// Stay on the scalar path for a run of non-ASCII
+			char32_t codePoint;
+			i += decodeWide(w + i, length - i, codePoint);
+			switch (utf8Units(codePoint)) {
+			case 2:
+				*out++ = static_cast<char>(0xC0 | (codePoint >> 6));
+				*out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+				break;
+			case 3:
+				*out++ = static_cast<char>(0xE0 | (codePoint >> 12));
+				*out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				*out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+				break;
+			default:
+				*out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+				*out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+				*out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				*out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+				break;
+			}
+		}
+	}
+	return utf8;
+}
+
+bool UtfTranscoder::isValidUtf8(const std::string_view &utf8) {
+	const unsigned char *s = reinterpret_cast<const unsigned char*>(utf8.data());
+	const size_t length = utf8.length();
+	size_t i = 0;
+	while (i < length) {
+		i += asciiPrefix(s + i, length - i);
+		if (i < length) {
+			char32_t codePoint;
+			const size_t consumed = decodeUtf8(s + i, length - i, codePoint);
+			if (codePoint == replacementCharacter && !(consumed == 3 && s[i] == 0xEF && s[i + 1] == 0xBF && s[i + 2] == 0xBD)) {
+				return false;
+			}
+			i += consumed;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+// Copyright (c) Nouman Tajik [github.com/tajiknomi]
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE. 
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/* UTF-8 <---> wide string (UTF-16 where wchar_t is 16 bits i.e. Windows, UTF-32 elsewhere).
+   Input is validated: ill-formed sequences, overlong forms, surrogates and unpaired surrogates each become U+FFFD,
+   nothing throws. Output is sized exactly by a counting pass, ASCII runs are handled 16 bytes at a time */
+class UtfTranscoder {
+
+public:
+	static size_t wideLength(const std::string_view &utf8);			/* wchar_t units utf8ToWide() produces */
+	static size_t utf8Length(const std::wstring_view &wide);		/* Bytes wideToUtf8() produces */
+	static std::wstring utf8ToWide(const std::string_view &utf8);
+	static std::string wideToUtf8(const std::wstring_view &wide);
+	static bool isValidUtf8(const std::string_view &utf8);
+};